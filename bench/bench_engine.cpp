@@ -0,0 +1,93 @@
+/*
+ * 多路流解析引擎性能测试：流数量增加时每MB数据消耗的CPU时间
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include "easy_h264_engine.h"
+#include "bench_util.h"
+#include <sys/resource.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACKET_SIZE 1400 // 模拟网络接收，每次输入一个包
+#define BYTES_PER_STREAM (16*1024*1024)
+
+/* 进程消耗的CPU时间(用户态+内核态)，包括所有线程 */
+static double cpu_ms()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0
+		+ (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+}
+
+static void RunBench(const unsigned char *data, int len, int streams, int workers)
+{
+	std::vector<long long> nalus(streams, 0);
+	H264StreamEngine engine(workers, streams);
+	for (int i = 0; i < streams; i++)
+		engine.AddStream([&nalus](int stream, Nalu &nalu, const SliceHeader *slice) { nalus[stream]++; });
+
+	/* 一个线程按包轮流输入所有流，队列满时等待工作线程处理 */
+	std::vector<int> pos(streams, 0);
+	long long total = (long long)BYTES_PER_STREAM * streams;
+	long long fed = 0;
+	double wall = now_ms(), cpu = cpu_ms();
+	while (fed < total)
+	{
+		for (int i = 0; i < streams; i++)
+		{
+			if (pos[i] >= BYTES_PER_STREAM)
+				continue;
+			int offset = pos[i] % len;
+			int n = len - offset < PACKET_SIZE ? len - offset : PACKET_SIZE;
+			if (!engine.Push(i, data + offset, n))
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			pos[i] += n;
+			fed += n;
+			if (pos[i] >= BYTES_PER_STREAM)
+				engine.Flush(i);
+		}
+	}
+	engine.WaitIdle();
+	wall = now_ms() - wall;
+	cpu = cpu_ms() - cpu;
+
+	double mb = total / 1048576.0;
+	printf("  %4d streams %2d workers %10.1f MB/s %8.1f us cpu/MB %10lld nalus/stream\n",
+		streams, engine.GetWorkerCount(), mb / (wall / 1000.0), cpu * 1000.0 / mb, nalus[0]);
+}
+
+int main(int argc, char **argv)
+{
+	const char *file = argc > 1 ? argv[1] : "zhiling.264";
+	FILE *fp = fopen(file, "rb");
+	if (!fp)
+	{
+		printf("open %s fail\n", file);
+		return -1;
+	}
+	fseek(fp, 0L, SEEK_END);
+	int size = ftell(fp);
+	fseek(fp, 0L, SEEK_SET);
+	unsigned char *data = (unsigned char *)malloc(size);
+	if (fread(data, 1, size, fp) != (size_t)size)
+		size = 0;
+	fclose(fp);
+
+	if (size > 0)
+	{
+		printf("%s: %d MB per stream, %d bytes per packet\n", file, BYTES_PER_STREAM >> 20, PACKET_SIZE);
+		int counts[] = { 1, 16, 64, 256 };
+		for (int i = 0; i < 4; i++)
+			RunBench(data, size, counts[i], 0);
+	}
+	free(data);
+	return 0;
+}
+
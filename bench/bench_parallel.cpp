@@ -0,0 +1,110 @@
+/*
+ * 分段并行查找起始码性能测试：不同线程数下的吞吐量
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include "easy_h264_parallel.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYNTHETIC_SIZE (512*1024*1024)
+
+/* 构造合成码流：伪随机负载(已做防竞争处理)，平均每个NALU约8KB */
+static unsigned char *MakeSyntheticStream(int size)
+{
+	unsigned char *buf = (unsigned char *)malloc(size);
+	unsigned int seed = 12345;
+	int i = 0, zeros = 0;
+	while (i < size - 4)
+	{
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) % 8192 == 0)
+		{
+			buf[i++] = 0; buf[i++] = 0; buf[i++] = 0; buf[i++] = 1;
+			zeros = 0;
+			continue;
+		}
+		unsigned char b = (seed >> 24) & 0xff;
+		if (zeros >= 2 && b <= 3)
+		{
+			buf[i++] = 3;
+			zeros = 0;
+			continue;
+		}
+		buf[i++] = b;
+		zeros = b ? 0 : zeros + 1;
+	}
+	while (i < size)
+		buf[i++] = 0xff;
+	return buf;
+}
+
+/* 与串行查找的结果逐个比较 */
+static bool SameNalus(std::vector<Nalu> &a, std::vector<Nalu> &b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].GetData() != b[i].GetData() || a[i].GetLength() != b[i].GetLength())
+			return false;
+	}
+	return true;
+}
+
+static void RunBench(const char *name, const unsigned char *data, int len, int loops)
+{
+	int hw = std::thread::hardware_concurrency();
+	printf("%s: %d bytes x %d loops, %d cores, scan impl: %s\n", name, len, loops, hw, GetStartCodeScanImpl());
+
+	NaluParse serial(true);
+	double t = now_ms();
+	std::vector<Nalu> *expect = NULL;
+	for (int n = 0; n < loops; n++)
+		expect = &serial.GetNalusFromFrame(data, len);
+	t = now_ms() - t;
+	double base = (double)len * loops / 1048576.0 / (t / 1000.0);
+	printf("  %-8s %8zu nalus %10.1f MB/s\n", "serial", expect->size(), base);
+
+	int maxThreads = hw > 0 ? hw * 2 : 2;
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		H264ParallelScan scan(threads);
+		std::vector<Nalu> *nalus = NULL;
+		t = now_ms();
+		for (int n = 0; n < loops; n++)
+			nalus = &scan.Scan(data, len);
+		t = now_ms() - t;
+		double speed = (double)len * loops / 1048576.0 / (t / 1000.0);
+		printf("  %2d thread%s %8zu nalus %10.1f MB/s %6.2fx%s\n", threads, threads > 1 ? "s" : " ",
+			nalus->size(), speed, speed / base, SameNalus(*nalus, *expect) ? "" : "  MISMATCH");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *file = argc > 1 ? argv[1] : "zhiling.264";
+	FILE *fp = fopen(file, "rb");
+	if (fp)
+	{
+		fseek(fp, 0L, SEEK_END);
+		int size = ftell(fp);
+		fseek(fp, 0L, SEEK_SET);
+		unsigned char *data = (unsigned char *)malloc(size);
+		if (fread(data, 1, size, fp) == (size_t)size)
+			RunBench(file, data, size, 200);
+		free(data);
+		fclose(fp);
+	}
+	else
+		printf("open %s fail, skip\n", file);
+
+	unsigned char *syn = MakeSyntheticStream(SYNTHETIC_SIZE);
+	RunBench("synthetic", syn, SYNTHETIC_SIZE, 4);
+	free(syn);
+	return 0;
+}
+
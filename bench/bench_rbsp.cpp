@@ -0,0 +1,134 @@
+/*
+ * EBSP转RBSP性能测试：逐字节push_back vs 整块拷贝
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include "easy_h264_parser.h"
+#include "easy_h264_scan.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYNTHETIC_SIZE (8*1024*1024)
+
+/* 原Nalu::GetRBSP的实现，作为对比基准 */
+static int LegacyGetRBSP(const unsigned char *pdata, int length, std::vector<unsigned char> &rbsp)
+{
+	rbsp.clear();
+	for (int i = 0; i < length; i++)
+	{
+		if (pdata[i] == 0x03)
+		{
+			if (i > 2)
+			{
+				if (pdata[i - 1] == 0x00 && pdata[i - 2] == 0x00)
+				{
+					if (i < length - 1)
+					{
+						if (pdata[i + 1] == 0x00
+							|| pdata[i + 1] == 0x01
+							|| pdata[i + 1] == 0x02
+							|| pdata[i + 1] == 0x03)
+						{
+							continue;
+						}
+					}
+				}
+			}
+		}
+		rbsp.push_back(pdata[i]);
+	}
+	return rbsp.size();
+}
+
+/* 构造一个大的IDR slice：伪随机数据，每约4KB出现一次需要插入防竞争字节的 00 00 0x */
+static unsigned char *MakeSyntheticSlice(int size)
+{
+	unsigned char *buf = (unsigned char *)malloc(size);
+	unsigned int seed = 54321;
+	int i = 0;
+	buf[i++] = 0x65;
+	while (i < size - 4)
+	{
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) % 4096 == 0)
+		{
+			buf[i++] = 0; buf[i++] = 0; buf[i++] = 3; buf[i++] = (seed >> 8) & 0x3;
+			continue;
+		}
+		unsigned char b = (seed >> 24) & 0xff;
+		buf[i++] = b ? b : 0x80; // 避免出现未插入防竞争字节的 00 00
+	}
+	while (i < size)
+		buf[i++] = 0x80;
+	return buf;
+}
+
+static void RunBench(const char *name, unsigned char *data, int len, int loops)
+{
+	std::vector<unsigned char> rbsp;
+	printf("%s: %d bytes x %d loops\n", name, len, loops);
+
+	double t = now_ms();
+	int expect = 0;
+	for (int n = 0; n < loops; n++)
+		expect = LegacyGetRBSP(data, len, rbsp);
+	t = now_ms() - t;
+	printf("  %-10s %10d bytes %10.1f MB/s\n", "legacy", expect, (double)len * loops / 1048576.0 / (t / 1000.0));
+
+	Nalu nalu;
+	nalu.SetData(data, len);
+	t = now_ms();
+	int size = 0;
+	for (int n = 0; n < loops; n++)
+	{
+		nalu.GetRBSP(rbsp);
+		size = rbsp.size();
+	}
+	t = now_ms() - t;
+	printf("  %-10s %10d bytes %10.1f MB/s\n", "vector", size, (double)len * loops / 1048576.0 / (t / 1000.0));
+
+	unsigned char *out = (unsigned char *)malloc(len);
+	t = now_ms();
+	for (int n = 0; n < loops; n++)
+		size = EbspToRbsp(data, len, out);
+	t = now_ms() - t;
+	printf("  %-10s %10d bytes %10.1f MB/s\n", "buffer", size, (double)len * loops / 1048576.0 / (t / 1000.0));
+
+	/* 原地转换会破坏输入，每次先恢复数据(恢复的拷贝不计时) */
+	unsigned char *work = (unsigned char *)malloc(len);
+	double total = 0;
+	for (int n = 0; n < loops; n++)
+	{
+		memcpy(work, data, len);
+		t = now_ms();
+		size = EbspToRbsp(work, len, work);
+		total += now_ms() - t;
+	}
+	printf("  %-10s %10d bytes %10.1f MB/s\n", "in-place", size, (double)len * loops / 1048576.0 / (total / 1000.0));
+	free(work);
+	free(out);
+}
+
+int main(int argc, char **argv)
+{
+	const char *file = argc > 1 ? argv[1] : "zhiling.264";
+	H264FileParse h264(file);
+	Nalu nalu, idr;
+	while (h264.GetNextNalu(nalu))
+	{
+		if (nalu.GetNaluType() == NALU_TYPE_IDR && nalu.GetLength() > idr.GetLength())
+			idr = nalu;
+	}
+	if (idr.GetLength() > 0)
+		RunBench("IDR slice", idr.GetData(), idr.GetLength(), 2000);
+	else
+		printf("no IDR slice in %s, skip\n", file);
+
+	unsigned char *syn = MakeSyntheticSlice(SYNTHETIC_SIZE);
+	RunBench("synthetic", syn, SYNTHETIC_SIZE, 20);
+	free(syn);
+	return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * 起始码查找性能测试：逐字节查找 vs SIMD查找
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include "easy_h264_parser.h"
+#include "easy_h264_scan.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYNTHETIC_SIZE (256*1024*1024)
+
+/* 原NaluParse::GetNalusFromFrame中的逐字节查找，作为对比基准 */
+static int CountStartCodesLegacy(const unsigned char *stream, int len)
+{
+	int i = 0, startCode = -1, count = 0;
+	for (i = 0; i < len - 4;)
+	{
+		if (stream[i] == 0 && stream[i + 1] == 0
+			&& stream[i + 2] == 1)
+		{
+			startCode = i + 3;
+		}
+		else if (stream[i] == 0 && stream[i + 1] == 0
+			&& stream[i + 2] == 0 && stream[i + 3] == 1)
+		{
+			startCode = i + 4;
+		}
+
+		if (startCode > 0)
+		{
+			count++;
+			i = startCode;
+			startCode = -1;
+		}
+		else
+			i++;
+	}
+	return count;
+}
+
+static int CountStartCodes(FindStartCodeFunc func, const unsigned char *stream, int len)
+{
+	int count = 0, startCodeLen = 0;
+	const unsigned char *end = stream + len;
+	const unsigned char *p = func(stream, end, &startCodeLen);
+	while (p && (p - stream) < len - 4)
+	{
+		count++;
+		p = func(p + startCodeLen, end, &startCodeLen);
+	}
+	return count;
+}
+
+/* 构造合成码流：伪随机负载(已做防竞争处理)，平均每个NALU约8KB */
+static unsigned char *MakeSyntheticStream(int size)
+{
+	unsigned char *buf = (unsigned char *)malloc(size);
+	unsigned int seed = 12345;
+	int i = 0, zeros = 0;
+	while (i < size - 4)
+	{
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) % 8192 == 0)
+		{
+			buf[i++] = 0; buf[i++] = 0; buf[i++] = 0; buf[i++] = 1;
+			zeros = 0;
+			continue;
+		}
+		unsigned char b = (seed >> 24) & 0xff;
+		if (zeros >= 2 && b <= 3)
+		{
+			buf[i++] = 3;
+			zeros = 0;
+			continue;
+		}
+		buf[i++] = b;
+		zeros = b ? 0 : zeros + 1;
+	}
+	while (i < size)
+		buf[i++] = 0xff;
+	return buf;
+}
+
+static void RunBench(const char *name, const unsigned char *data, int len, int loops)
+{
+	printf("%s: %d bytes x %d loops, default impl: %s\n", name, len, loops, GetStartCodeScanImpl());
+
+	double t = now_ms();
+	int expect = 0;
+	for (int n = 0; n < loops; n++)
+		expect = CountStartCodesLegacy(data, len);
+	t = now_ms() - t;
+	printf("  %-8s %8d start codes %10.1f MB/s\n", "legacy", expect, (double)len * loops / 1048576.0 / (t / 1000.0));
+
+	const char *impls[] = { "scalar", "sse2", "avx2" };
+	for (int k = 0; k < 3; k++)
+	{
+		FindStartCodeFunc func = GetFindStartCodeFunc(impls[k]);
+		if (!func)
+		{
+			printf("  %-8s unsupported\n", impls[k]);
+			continue;
+		}
+		t = now_ms();
+		int count = 0;
+		for (int n = 0; n < loops; n++)
+			count = CountStartCodes(func, data, len);
+		t = now_ms() - t;
+		printf("  %-8s %8d start codes %10.1f MB/s%s\n", impls[k], count,
+			(double)len * loops / 1048576.0 / (t / 1000.0), count == expect ? "" : "  MISMATCH");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *file = argc > 1 ? argv[1] : "zhiling.264";
+	FILE *fp = fopen(file, "rb");
+	if (fp)
+	{
+		fseek(fp, 0L, SEEK_END);
+		int size = ftell(fp);
+		fseek(fp, 0L, SEEK_SET);
+		unsigned char *data = (unsigned char *)malloc(size);
+		if (fread(data, 1, size, fp) == (size_t)size)
+			RunBench(file, data, size, 2000);
+		free(data);
+		fclose(fp);
+	}
+	else
+		printf("open %s fail, skip\n", file);
+
+	unsigned char *syn = MakeSyntheticStream(SYNTHETIC_SIZE);
+	RunBench("synthetic", syn, SYNTHETIC_SIZE, 4);
+	free(syn);
+	return 0;
+}
@@ -0,0 +1,776 @@
+/*
+ * 性能测试套件：起始码查找、RBSP转换、指数哥伦布解码、参数集/slice头解析、SEI遍历、文件解析端到端吞吐量、
+ * 热路径及解析器频繁创建时的内存分配
+ * 每项测试自动调整迭代次数，输出MB/s、个/s、每个头的耗时及每次迭代的内存分配次数
+ * 支持JSON/CSV输出，用于不同版本之间的比较
+ *
+ * 用法：bench_suite [--file=zhiling.264] [--synthetic_mb=64] [--min_time=0.5] [--filter=子串] [--format=console|json|csv]
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include "easy_h264_parser.h"
+#include "easy_h264_slice.h"
+#include "easy_h264_sei.h"
+#include "easy_h264_ts.h"
+#include "bench_util.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <memory>
+#include <new>
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 内存分配统计
+static unsigned long long allocCount = 0;
+
+void *operator new(size_t size)
+{
+	allocCount++;
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	free(p);
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 测试框架
+// 每次迭代处理的数据量，由测试函数填写
+typedef struct BenchCounters
+{
+	double bytes; // 字节数，用于计算MB/s
+	double items; // 个数(NALU、头、码字)，用于计算个/s及每个的耗时
+}BenchCounters;
+
+/* 执行iters次迭代，counters为所有迭代的累计值 */
+typedef std::function<void(long long iters, BenchCounters &counters)> BenchFunc;
+
+typedef struct BenchCase
+{
+	std::string name;
+	std::string itemName; // items的单位：nalus、headers、codes等
+	BenchFunc func;
+}BenchCase;
+
+typedef struct BenchResult
+{
+	std::string name;
+	std::string itemName;
+	long long iterations;
+	double nsPerIter;
+	double mbPerSec;
+	double itemsPerSec;
+	double nsPerItem;
+	double allocsPerIter;
+}BenchResult;
+
+static std::vector<BenchCase> benchCases;
+
+static void AddBench(const std::string &name, const char *itemName, const BenchFunc &func)
+{
+	BenchCase c;
+	c.name = name;
+	c.itemName = itemName;
+	c.func = func;
+	benchCases.push_back(c);
+}
+
+/* 先执行一次预热，然后迭代次数逐步增大，直到耗时超过minTime */
+static BenchResult RunBench(BenchCase &c, double minTime)
+{
+	BenchCounters counters;
+	counters.bytes = counters.items = 0;
+	c.func(1, counters);
+
+	long long iters = 1;
+	double t = 0;
+	unsigned long long allocs = 0;
+	while (true)
+	{
+		counters.bytes = counters.items = 0;
+		allocs = allocCount;
+		t = now_ns();
+		c.func(iters, counters);
+		t = now_ns() - t;
+		allocs = allocCount - allocs;
+		if (t >= minTime * 1e9 || iters >= 1000000000LL)
+			break;
+
+		double scale = t > 0 ? minTime * 1e9 * 1.2 / t : 10;
+		scale = scale < 2 ? 2 : (scale > 10 ? 10 : scale);
+		iters = (long long)(iters * scale);
+	}
+
+	BenchResult r;
+	r.name = c.name;
+	r.itemName = c.itemName;
+	r.iterations = iters;
+	r.nsPerIter = t / iters;
+	r.mbPerSec = counters.bytes > 0 ? counters.bytes / 1048576.0 / (t / 1e9) : 0;
+	r.itemsPerSec = counters.items > 0 ? counters.items / (t / 1e9) : 0;
+	r.nsPerItem = counters.items > 0 ? t / counters.items : 0;
+	r.allocsPerIter = (double)allocs / iters;
+	return r;
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 测试数据
+static volatile unsigned long long sink = 0;
+
+/* High profile SPS/PPS：缩放矩阵、POC类型1、裁剪到1920x1080(含防竞争字节)，CABAC、transform_8x8_mode_flag */
+static const unsigned char highSps[] = {
+	0x00, 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x28, 0x22, 0xda, 0x49, 0x24, 0x92, 0x49, 0x24, 0x90,
+	0x29, 0x24, 0x92, 0x49, 0x24, 0x92, 0x49, 0x24, 0x92, 0x49, 0x24, 0x92, 0x49, 0x24, 0x92, 0x49,
+	0x24, 0x92, 0x49, 0x24, 0x92, 0x49, 0x24, 0x92, 0x42, 0xa1, 0x45, 0x90, 0x00, 0x02, 0x00, 0x00,
+	0x03, 0x00, 0x00, 0x88, 0xb8, 0x65, 0x01, 0xe0, 0x08, 0x9f, 0x95
+};
+static const unsigned char highPps[] = {
+	0x00, 0x00, 0x00, 0x01, 0x68, 0x01, 0x92, 0x4a, 0xf8, 0xf2, 0xc8, 0x44
+};
+
+static bool LoadFile(const char *file, std::vector<unsigned char> &data)
+{
+	FILE *fp = fopen(file, "rb");
+	if (!fp)
+		return false;
+	unsigned char buf[65536];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		data.insert(data.end(), buf, buf + n);
+	fclose(fp);
+	return !data.empty();
+}
+
+/*
+ * 合成码流：固定种子，每次生成的内容相同
+ * 开头为prefix(通常是真实码流的SPS/PPS)，之后为平均约8KB的slice，每30个为一个IDR，负载已做防竞争处理
+ */
+static void MakeSyntheticStream(std::vector<unsigned char> &out, size_t size, const std::vector<unsigned char> &prefix)
+{
+	out.clear();
+	out.reserve(size + 16);
+	out.insert(out.end(), prefix.begin(), prefix.end());
+	unsigned int seed = 12345;
+	int zeros = 0, slices = 0;
+	while (out.size() < size)
+	{
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) % 8192 == 0 || out.size() == prefix.size())
+		{
+			static const unsigned char sc[4] = { 0, 0, 0, 1 };
+			out.insert(out.end(), sc, sc + 4);
+			out.push_back(slices++ % 30 == 0 ? 0x65 : 0x41);
+			out.push_back(0x88); // first_mb_in_slice=0
+			zeros = 0;
+			continue;
+		}
+		unsigned char b = (seed >> 24) & 0xff;
+		if (zeros >= 2 && b <= 3)
+		{
+			out.push_back(3);
+			zeros = 0;
+		}
+		out.push_back(b);
+		zeros = b ? 0 : zeros + 1;
+	}
+	out.push_back(0x80); // 不以0x00结尾
+}
+
+/* 生成count个指数哥伦布码，取值集中在较小的数(与运动矢量差、参考索引等分布相近) */
+static void MakeExpGolomb(std::vector<unsigned char> &out, int count)
+{
+	out.assign(count * 4 + 16, 0);
+	unsigned int seed = 54321;
+	size_t bit = 0;
+	for (int i = 0; i < count; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		unsigned int v = ((seed >> 16) & 0xff) >> ((seed >> 24) & 7); // 0~255，偏向小值
+		unsigned int code = v + 1;
+		int len = 0;
+		while ((code >> len) > 1)
+			len++;
+		bit += len; // 前导0
+		for (int k = len; k >= 0; k--, bit++)
+		{
+			if ((code >> k) & 1)
+				out[bit >> 3] |= 0x80 >> (bit & 7);
+		}
+	}
+	out.resize((bit + 7) / 8 + 8);
+}
+
+static Nalu FindNalu(std::vector<Nalu> &nalus, int type)
+{
+	for (size_t i = 0; i < nalus.size(); i++)
+	{
+		if (nalus[i].GetNaluType() == type)
+			return nalus[i];
+	}
+	return Nalu();
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 测试项
+static void AddStreamBenches(const std::string &tag, const std::vector<unsigned char> &stream)
+{
+	const unsigned char *data = stream.data();
+	int len = (int)stream.size();
+
+	AddBench("scan/FindStartCode/" + tag, "startcodes", [data, len](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			const unsigned char *p = data, *end = data + len;
+			int startCodeLen = 0, count = 0;
+			while ((p = FindStartCode(p, end, &startCodeLen)) != NULL)
+			{
+				p += startCodeLen;
+				count++;
+			}
+			c.bytes += len;
+			c.items += count;
+		}
+	});
+
+	std::shared_ptr<NaluParse> parse(new NaluParse(true));
+	AddBench("NaluParse/zero-copy/" + tag, "nalus", [parse, data, len](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			c.items += parse->GetNalusFromFrame(data, len).size();
+			c.bytes += len;
+		}
+	});
+
+	std::shared_ptr<std::vector<Nalu> > nalus(new std::vector<Nalu>(NaluParse(true).GetNalusFromFrame(data, len)));
+	std::shared_ptr<std::vector<unsigned char> > rbsp(new std::vector<unsigned char>());
+	AddBench("GetRBSP/vector/" + tag, "nalus", [nalus, rbsp](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			for (size_t i = 0; i < nalus->size(); i++)
+			{
+				(*nalus)[i].GetRBSP(*rbsp);
+				c.bytes += (*nalus)[i].GetLength();
+				sink += rbsp->size();
+			}
+			c.items += nalus->size();
+		}
+	});
+	AddBench("GetRBSP/buffer/" + tag, "nalus", [nalus, rbsp](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			for (size_t i = 0; i < nalus->size(); i++)
+			{
+				Nalu &nalu = (*nalus)[i];
+				if (rbsp->size() < (size_t)nalu.GetLength())
+					rbsp->resize(nalu.GetLength());
+				sink += nalu.GetRBSP(rbsp->data(), (int)rbsp->size());
+				c.bytes += nalu.GetLength();
+			}
+			c.items += nalus->size();
+		}
+	});
+}
+
+static void AddBitStreamBenches()
+{
+	const int count = 1 << 16;
+	std::shared_ptr<std::vector<unsigned char> > codes(new std::vector<unsigned char>());
+	MakeExpGolomb(*codes, count);
+
+	AddBench("BitStream/ReadUE", "codes", [codes, count](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			BitStream bs(codes->data(), (int)codes->size());
+			unsigned int sum = 0;
+			for (int i = 0; i < count; i++)
+				sum += bs.ReadUE();
+			sink += sum;
+			c.bytes += codes->size();
+			c.items += count;
+		}
+	});
+	AddBench("BitStream/ReadSE", "codes", [codes, count](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			BitStream bs(codes->data(), (int)codes->size());
+			int sum = 0;
+			for (int i = 0; i < count; i++)
+				sum += bs.ReadSE();
+			sink += sum;
+			c.bytes += codes->size();
+			c.items += count;
+		}
+	});
+}
+
+static void AddHeaderBenches(const std::string &tag, Nalu sps, Nalu pps, Nalu slice)
+{
+	if (!sps.GetLength() || !pps.GetLength())
+		return;
+
+	std::shared_ptr<SpsInfo> spsInfo(new SpsInfo());
+	std::shared_ptr<PpsInfo> ppsInfo(new PpsInfo());
+	ParseSps(sps.GetData(), sps.GetLength(), *spsInfo);
+	ParsePps(pps.GetData(), pps.GetLength(), *ppsInfo, spsInfo.get());
+
+	AddBench("ParseSps/" + tag, "headers", [sps, spsInfo](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			ParseSps(sps.pdata, sps.length, *spsInfo);
+			sink += spsInfo->pic_width_in_mbs_minus1;
+			c.bytes += sps.length;
+			c.items += 1;
+		}
+	});
+	AddBench("ParsePps/" + tag, "headers", [pps, spsInfo, ppsInfo](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			ParsePps(pps.pdata, pps.length, *ppsInfo, spsInfo.get());
+			sink += ppsInfo->pic_parameter_set_id;
+			c.bytes += pps.length;
+			c.items += 1;
+		}
+	});
+	/* 旧的类接口，每次构造都重新解析 */
+	AddBench("NaluSpsParse/" + tag, "headers", [sps](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			NaluSpsParse parse(sps.pdata, sps.length);
+			int width, height;
+			parse.GetRealWidthHeight(width, height);
+			sink += width;
+			c.bytes += sps.length;
+			c.items += 1;
+		}
+	});
+	AddBench("NaluPpsParse/" + tag, "headers", [pps](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			NaluPpsParse parse(pps.pdata, pps.length);
+			sink += parse.GetPicParameterSetId();
+			c.bytes += pps.length;
+			c.items += 1;
+		}
+	});
+	if (!slice.GetLength())
+		return;
+	AddBench("ParseSliceHeader/" + tag, "headers", [slice, spsInfo, ppsInfo](long long iters, BenchCounters &c) {
+		SliceHeader sh;
+		for (long long n = 0; n < iters; n++)
+		{
+			ParseSliceHeader(slice.pdata, slice.length, *spsInfo, *ppsInfo, sh);
+			sink += sh.frame_num;
+			c.items += 1;
+		}
+	});
+}
+
+/* SEI：2KB的user_data_unregistered(含防竞争字节)之后是recovery_point，比较逐条拷贝负载与只取recovery_point */
+static void AddSeiBenches()
+{
+	std::vector<unsigned char> rbsp;
+	rbsp.push_back(SEI_USER_DATA_UNREGISTERED);
+	int userSize = 2048;
+	for (int n = userSize; n >= 255; n -= 255)
+		rbsp.push_back(0xFF);
+	rbsp.push_back(userSize % 255);
+	unsigned int seed = 1;
+	for (int i = 0; i < userSize; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		rbsp.push_back((seed >> 16) % 4 == 0 ? 0 : (unsigned char)(seed >> 24));
+	}
+	/* 0x88：recovery_frame_cnt=0等字段及负载的对齐位，0x80为rbsp_trailing_bits */
+	static const unsigned char recovery[] = { SEI_RECOVERY_POINT, 1, 0x88, 0x80 };
+	rbsp.insert(rbsp.end(), recovery, recovery + sizeof(recovery));
+
+	/* 加入防竞争字节 */
+	std::shared_ptr<std::vector<unsigned char>> sei(new std::vector<unsigned char>());
+	sei->push_back(NALU_TYPE_SEI);
+	int zeros = 0;
+	for (size_t i = 0; i < rbsp.size(); i++)
+	{
+		if (zeros >= 2 && rbsp[i] <= 3)
+		{
+			sei->push_back(3);
+			zeros = 0;
+		}
+		sei->push_back(rbsp[i]);
+		zeros = rbsp[i] == 0 ? zeros + 1 : 0;
+	}
+
+	AddBench("SeiIterator/copy-all", "seis", [sei](long long iters, BenchCounters &c) {
+		std::vector<unsigned char> buf(4096);
+		for (long long n = 0; n < iters; n++)
+		{
+			SeiIterator it(sei->data(), (int)sei->size());
+			SeiMessage msg;
+			while (it.Next(msg))
+				sink += msg.CopyPayload(buf.data(), (int)buf.size());
+			c.bytes += sei->size();
+			c.items += 1;
+		}
+	});
+	AddBench("SeiIterator/recovery_point", "seis", [sei](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			SeiIterator it(sei->data(), (int)sei->size());
+			it.Accept(SEI_RECOVERY_POINT);
+			SeiMessage msg;
+			SeiRecoveryPoint rp;
+			while (it.Next(msg))
+			{
+				if (ParseSeiRecoveryPoint(msg, rp))
+					sink += rp.recovery_frame_cnt + 1;
+			}
+			c.bytes += sei->size();
+			c.items += 1;
+		}
+	});
+}
+
+/* 把每个NALU封装为一个带PTS的PES，视频PID为0x100，每64个PES插入一次PAT/PMT(各带pointer_field) */
+static void MakeTsStream(std::vector<unsigned char> &out, const std::vector<unsigned char> &stream)
+{
+	static const unsigned char pat[] = {
+		0x00, 0x00, 0xB0, 0x0D, 0x00, 0x01, 0xC1, 0x00, 0x00, 0x00, 0x01, 0xF0, 0x00, 0x2A, 0xB1, 0x04, 0xB2
+	};
+	static const unsigned char pmt[] = {
+		0x00, 0x02, 0xB0, 0x12, 0x00, 0x01, 0xC1, 0x00, 0x00, 0xE1, 0x00, 0xF0, 0x00,
+		0x1B, 0xE1, 0x00, 0xF0, 0x00, 0x15, 0xBD, 0x4D, 0x56
+	};
+	std::vector<Nalu> nalus = NaluParse(true).GetNalusFromFrame(stream.data(), (int)stream.size());
+	static const int pids[3] = { TS_PID_PAT, 0x1000, 0x100 };
+	int cc[3] = { 0, 0, 0 };
+	for (size_t i = 0; i < nalus.size(); i++)
+	{
+		std::vector<unsigned char> pes;
+		static const unsigned char header[] = { 0x00, 0x00, 0x01, 0xE0, 0x00, 0x00, 0x80, 0x80, 0x05 };
+		pes.insert(pes.end(), header, header + sizeof(header));
+		long long pts = (long long)i * 3600;
+		pes.push_back(0x21 | (unsigned char)(((pts >> 30) & 0x07) << 1));
+		pes.push_back((unsigned char)(pts >> 22));
+		pes.push_back((unsigned char)(((pts >> 15) & 0x7F) << 1) | 1);
+		pes.push_back((unsigned char)(pts >> 7));
+		pes.push_back((unsigned char)((pts & 0x7F) << 1) | 1);
+		static const unsigned char sc[4] = { 0, 0, 0, 1 };
+		pes.insert(pes.end(), sc, sc + 4);
+		pes.insert(pes.end(), nalus[i].GetData(), nalus[i].GetData() + nalus[i].GetLength());
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (k < 2 && i % 64 != 0)
+				continue;
+			int pid = pids[k];
+			const unsigned char *data = k == 0 ? pat : (k == 1 ? pmt : pes.data());
+			size_t len = k == 0 ? sizeof(pat) : (k == 1 ? sizeof(pmt) : pes.size());
+			for (size_t pos = 0; pos < len; )
+			{
+				size_t take = len - pos < 184 ? len - pos : 184;
+				out.push_back(TS_SYNC_BYTE);
+				out.push_back((pos == 0 ? 0x40 : 0) | (pid >> 8));
+				out.push_back(pid & 0xFF);
+				if (take < 184) // 用adaptation_field填充
+				{
+					out.push_back(0x30 | cc[k]);
+					size_t stuff = 184 - take - 1;
+					out.push_back((unsigned char)stuff);
+					if (stuff > 0)
+					{
+						out.push_back(0x00);
+						out.insert(out.end(), stuff - 1, 0xFF);
+					}
+				}
+				else
+					out.push_back(0x10 | cc[k]);
+				out.insert(out.end(), data + pos, data + pos + take);
+				cc[k] = (cc[k] + 1) & 0x0F;
+				pos += take;
+			}
+		}
+	}
+}
+
+/* TS解复用：PES重组、PTS提取及零拷贝拆分NALU */
+static void AddTsBenches(const std::string &tag, const std::vector<unsigned char> &stream)
+{
+	std::shared_ptr<std::vector<unsigned char>> ts(new std::vector<unsigned char>());
+	MakeTsStream(*ts, stream);
+	AddBench("H264TsDemux/" + tag, "nalus", [ts](long long iters, BenchCounters &c) {
+		long long count = 0;
+		H264TsDemux demux([&count](Nalu &nalu, const TsTimestamp &t) {
+			sink += nalu.GetLength() + t.pts;
+			count++;
+		});
+		for (long long n = 0; n < iters; n++)
+		{
+			demux.Feed(ts->data(), (int)ts->size());
+			demux.Flush();
+			c.bytes += ts->size();
+		}
+		c.items += count;
+	});
+}
+
+/*
+ * 内存分配：拷贝模式及按包输入的热路径(缓冲区稳定后应为0)，
+ * 以及实例频繁创建销毁时默认分配器与slab内存池的对比
+ */
+static void AddAllocBenches(const std::string &tag, const std::vector<unsigned char> &stream, const std::string &file)
+{
+	const unsigned char *data = stream.data();
+	int len = (int)stream.size();
+
+	std::shared_ptr<NaluParse> copyParse(new NaluParse(false));
+	AddBench("NaluParse/copy/" + tag, "nalus", [copyParse, data, len](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			c.items += copyParse->GetNalusFromFrame(data, len).size();
+			c.bytes += len;
+		}
+	});
+
+	/* 模拟网络接收，每次输入一个包，到达结尾后从头循环 */
+	const int packetSize = 1400;
+	std::shared_ptr<int> pos(new int(0));
+	std::shared_ptr<H264StreamParse> streamParse(new H264StreamParse([](Nalu &nalu) { sink += nalu.GetLength(); }));
+	AddBench("H264StreamParse/1400B-packets/" + tag, "packets", [streamParse, pos, data, len, packetSize](long long iters, BenchCounters &c) {
+		for (long long n = 0; n < iters; n++)
+		{
+			int take = len - *pos < packetSize ? len - *pos : packetSize;
+			streamParse->Feed(data + *pos, take);
+			*pos = (*pos + take) % len;
+			c.bytes += take;
+			c.items += 1;
+		}
+	});
+
+	const char *names[] = { "default", "slab" };
+	H264Allocator *allocators[] = { NULL, GetSharedSlabPool() };
+	for (int k = 0; k < 2; k++)
+	{
+		H264Allocator *allocator = allocators[k];
+		AddBench(std::string("NaluParse/churn-") + names[k] + "/" + tag, "nalus", [allocator, data, len](long long iters, BenchCounters &c) {
+			for (long long n = 0; n < iters; n++)
+			{
+				NaluParse parse(false, allocator);
+				c.items += parse.GetNalusFromFrame(data, len).size();
+				c.bytes += len;
+			}
+		});
+		/* 只取第一个NALU，主要是打开文件及申请读缓冲区的开销 */
+		AddBench(std::string("H264FileParse/churn-") + names[k] + "/" + tag, "opens", [allocator, file](long long iters, BenchCounters &c) {
+			for (long long n = 0; n < iters; n++)
+			{
+				H264FileParse h264(file, H264_FILE_READ_BUFFERED, allocator);
+				Nalu nalu;
+				sink += h264.GetNextNalu(nalu);
+				c.items += 1;
+			}
+		});
+	}
+}
+
+static void AddFileBenches(const std::string &tag, const std::string &file)
+{
+	const char *names[] = { "buffered", "mmap", "async" };
+	int modes[] = { H264_FILE_READ_BUFFERED, H264_FILE_READ_MMAP, H264_FILE_READ_ASYNC };
+	for (int i = 0; i < 3; i++)
+	{
+		int mode = modes[i];
+		AddBench(std::string("H264FileParse/") + names[i] + "/" + tag, "nalus", [file, mode](long long iters, BenchCounters &c) {
+			for (long long n = 0; n < iters; n++)
+			{
+				H264FileParse h264(file, mode);
+				Nalu nalu;
+				while (h264.GetNextNalu(nalu))
+				{
+					c.bytes += nalu.GetLength();
+					c.items += 1;
+				}
+			}
+		});
+	}
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 输出
+static void PrintConsole(const std::vector<BenchResult> &results)
+{
+	printf("%-40s %12s %12s %10s %14s %12s %10s\n", "benchmark", "iterations", "ns/iter", "MB/s", "items/s", "ns/item", "allocs/it");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult &r = results[i];
+		char items[64] = "-", perItem[32] = "-", mb[32] = "-";
+		if (r.itemsPerSec > 0)
+		{
+			snprintf(items, sizeof(items), "%.3g %s", r.itemsPerSec, r.itemName.c_str());
+			snprintf(perItem, sizeof(perItem), "%.1f", r.nsPerItem);
+		}
+		if (r.mbPerSec > 0)
+			snprintf(mb, sizeof(mb), "%.1f", r.mbPerSec);
+		printf("%-40s %12lld %12.1f %10s %14s %12s %10.3f\n", r.name.c_str(), r.iterations, r.nsPerIter, mb,
+			items, perItem, r.allocsPerIter);
+	}
+}
+
+static void PrintJson(const std::vector<BenchResult> &results, const char *file, int syntheticMb)
+{
+	char date[64];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+	char host[256] = "";
+	gethostname(host, sizeof(host) - 1);
+
+	printf("{\n  \"context\": {\n");
+	printf("    \"date\": \"%s\",\n", date);
+	printf("    \"host_name\": \"%s\",\n", host);
+	printf("    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+	printf("    \"scan_impl\": \"%s\",\n", GetStartCodeScanImpl());
+	printf("    \"file\": \"%s\",\n", file);
+	printf("    \"synthetic_mb\": %d\n", syntheticMb);
+	printf("  },\n  \"benchmarks\": [\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult &r = results[i];
+		printf("    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_iter\": %.3f, \"mb_per_second\": %.3f, "
+			"\"items_per_second\": %.3f, \"ns_per_item\": %.3f, \"item\": \"%s\", \"allocs_per_iter\": %.3f}%s\n",
+			r.name.c_str(), r.iterations, r.nsPerIter, r.mbPerSec, r.itemsPerSec, r.nsPerItem, r.itemName.c_str(),
+			r.allocsPerIter, i + 1 < results.size() ? "," : "");
+	}
+	printf("  ]\n}\n");
+}
+
+static void PrintCsv(const std::vector<BenchResult> &results)
+{
+	printf("name,iterations,ns_per_iter,mb_per_second,items_per_second,ns_per_item,item,allocs_per_iter\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult &r = results[i];
+		printf("%s,%lld,%.3f,%.3f,%.3f,%.3f,%s,%.3f\n", r.name.c_str(), r.iterations, r.nsPerIter, r.mbPerSec,
+			r.itemsPerSec, r.nsPerItem, r.itemName.c_str(), r.allocsPerIter);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *file = "zhiling.264";
+	const char *filter = "";
+	const char *format = "console";
+	double minTime = 0.5;
+	int syntheticMb = 64;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "--file=", 7))
+			file = argv[i] + 7;
+		else if (!strncmp(argv[i], "--filter=", 9))
+			filter = argv[i] + 9;
+		else if (!strncmp(argv[i], "--format=", 9))
+			format = argv[i] + 9;
+		else if (!strncmp(argv[i], "--min_time=", 11))
+			minTime = atof(argv[i] + 11);
+		else if (!strncmp(argv[i], "--synthetic_mb=", 15))
+			syntheticMb = atoi(argv[i] + 15);
+		else
+		{
+			printf("Usage: %s [--file=zhiling.264] [--synthetic_mb=64] [--min_time=0.5] [--filter=substr] [--format=console|json|csv]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	std::vector<unsigned char> real;
+	if (!LoadFile(file, real))
+	{
+		fprintf(stderr, "open %s fail\n", file);
+		return -1;
+	}
+
+	/* 真实码流的SPS/PPS/第一个IDR，合成码流以SPS/PPS开头 */
+	std::vector<Nalu> realNalus = NaluParse(true).GetNalusFromFrame(real.data(), (int)real.size());
+	Nalu sps = FindNalu(realNalus, NALU_TYPE_SPS);
+	Nalu pps = FindNalu(realNalus, NALU_TYPE_PPS);
+	Nalu idr = FindNalu(realNalus, NALU_TYPE_IDR);
+	std::vector<unsigned char> prefix;
+	static const unsigned char sc[4] = { 0, 0, 0, 1 };
+	if (sps.GetLength() && pps.GetLength())
+	{
+		prefix.insert(prefix.end(), sc, sc + 4);
+		prefix.insert(prefix.end(), sps.GetData(), sps.GetData() + sps.GetLength());
+		prefix.insert(prefix.end(), sc, sc + 4);
+		prefix.insert(prefix.end(), pps.GetData(), pps.GetData() + pps.GetLength());
+	}
+	std::vector<unsigned char> synthetic;
+	MakeSyntheticStream(synthetic, (size_t)syntheticMb * 1024 * 1024, prefix);
+
+	char syntheticFile[64];
+	snprintf(syntheticFile, sizeof(syntheticFile), "/tmp/bench_suite_%d.264", (int)getpid());
+	FILE *fp = fopen(syntheticFile, "wb");
+	if (!fp || fwrite(synthetic.data(), 1, synthetic.size(), fp) != synthetic.size())
+	{
+		fprintf(stderr, "write %s fail\n", syntheticFile);
+		if (fp)
+			fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	std::string fileTag = strrchr(file, '/') ? strrchr(file, '/') + 1 : file;
+	AddStreamBenches(fileTag, real);
+	AddStreamBenches("synthetic", synthetic);
+	AddBitStreamBenches();
+	AddHeaderBenches(fileTag, sps, pps, idr);
+	Nalu highSpsNalu, highPpsNalu;
+	highSpsNalu.SetData((unsigned char *)highSps + 4, sizeof(highSps) - 4);
+	highPpsNalu.SetData((unsigned char *)highPps + 4, sizeof(highPps) - 4);
+	AddHeaderBenches("high", highSpsNalu, highPpsNalu, Nalu());
+	AddSeiBenches();
+	AddTsBenches(fileTag, real);
+	AddAllocBenches(fileTag, real, file);
+	AddFileBenches(fileTag, file);
+	AddFileBenches("synthetic", syntheticFile);
+
+	std::vector<BenchResult> results;
+	for (size_t i = 0; i < benchCases.size(); i++)
+	{
+		if (*filter && benchCases[i].name.find(filter) == std::string::npos)
+			continue;
+		results.push_back(RunBench(benchCases[i], minTime));
+	}
+	unlink(syntheticFile);
+
+	if (!strcmp(format, "json"))
+		PrintJson(results, file, syntheticMb);
+	else if (!strcmp(format, "csv"))
+		PrintCsv(results);
+	else
+		PrintConsole(results);
+	return 0;
+}
+
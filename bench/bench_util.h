@@ -0,0 +1,23 @@
+/*
+ * 性能测试程序共用的计时函数，统一使用CLOCK_MONOTONIC(不受系统时间调整影响)
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_BENCH_UTIL_H__
+#define __FREE_EASY_H264_BENCH_UTIL_H__
+#include <time.h>
+
+static inline double now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static inline double now_ms()
+{
+	return now_ns() / 1e6;
+}
+
+#endif
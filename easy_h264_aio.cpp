@@ -0,0 +1,442 @@
+/*
+ * 异步预读实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "easy_h264_aio.h"
+#include "easy_h264_stats.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define EASY_H264_HAVE_IO_URING 1
+#endif
+#endif
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// io_uring：不依赖liburing，直接使用系统调用，SQ/CQ只由调用Acquire的线程访问
+#ifdef EASY_H264_HAVE_IO_URING
+struct AioRing
+{
+	AioRing()
+	{
+		fd = -1;
+		sqPtr = cqPtr = NULL;
+		sqes = NULL;
+		sqSize = cqSize = sqesSize = 0;
+	}
+
+	int fd;
+	void *sqPtr;
+	size_t sqSize;
+	void *cqPtr;
+	size_t cqSize;
+	struct io_uring_sqe *sqes;
+	size_t sqesSize;
+
+	unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+	unsigned *cqHead, *cqTail, *cqMask;
+	struct io_uring_cqe *cqes;
+
+	std::vector<struct iovec> iovs; // 每个缓冲区一个，READV在完成前需要iovec有效
+};
+
+static int IoUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+	int ret;
+	do
+	{
+		ret = (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+	return ret;
+}
+
+static void UringFree(AioRing *ring)
+{
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqesSize);
+	if (ring->cqPtr && ring->cqPtr != ring->sqPtr)
+		munmap(ring->cqPtr, ring->cqSize);
+	if (ring->sqPtr)
+		munmap(ring->sqPtr, ring->sqSize);
+	if (ring->fd >= 0)
+		close(ring->fd);
+	delete ring;
+}
+#else
+struct AioRing
+{};
+
+static void UringFree(AioRing *ring)
+{
+	delete ring;
+}
+#endif
+
+/* 创建io_uring，内核不支持(或被禁用)时返回false，使用线程方式 */
+bool H264AsyncReader::UringInit()
+{
+#ifdef EASY_H264_HAVE_IO_URING
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = (int)syscall(__NR_io_uring_setup, (unsigned)slots.size(), &params);
+	if (fd < 0)
+		return false;
+
+	AioRing *r = new AioRing;
+	r->fd = fd;
+	r->sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	r->cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	r->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single)
+		r->sqSize = r->cqSize = r->sqSize > r->cqSize ? r->sqSize : r->cqSize;
+
+	void *p = mmap(NULL, r->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (p == MAP_FAILED)
+	{
+		UringFree(r);
+		return false;
+	}
+	r->sqPtr = p;
+	if (single)
+		r->cqPtr = p;
+	else
+	{
+		p = mmap(NULL, r->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (p == MAP_FAILED)
+		{
+			UringFree(r);
+			return false;
+		}
+		r->cqPtr = p;
+	}
+	p = mmap(NULL, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (p == MAP_FAILED)
+	{
+		UringFree(r);
+		return false;
+	}
+	r->sqes = (struct io_uring_sqe *)p;
+
+	unsigned char *sq = (unsigned char *)r->sqPtr;
+	unsigned char *cq = (unsigned char *)r->cqPtr;
+	r->sqHead = (unsigned *)(sq + params.sq_off.head);
+	r->sqTail = (unsigned *)(sq + params.sq_off.tail);
+	r->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+	r->sqArray = (unsigned *)(sq + params.sq_off.array);
+	r->cqHead = (unsigned *)(cq + params.cq_off.head);
+	r->cqTail = (unsigned *)(cq + params.cq_off.tail);
+	r->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+	r->iovs.resize(slots.size());
+	ring = r;
+	return true;
+#else
+	return false;
+#endif
+}
+
+/* 提交一个缓冲区的读取(或短读后剩余部分的读取) */
+void H264AsyncReader::UringSubmit(int index)
+{
+#ifdef EASY_H264_HAVE_IO_URING
+	Slot &slot = slots[index];
+	struct iovec &iov = ring->iovs[index];
+	iov.iov_base = slot.base + headroom + slot.filled;
+	iov.iov_len = chunkSize - slot.filled;
+
+	unsigned tail = *ring->sqTail;
+	unsigned pos = tail & *ring->sqMask;
+	struct io_uring_sqe *sqe = &ring->sqes[pos];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_READV; // READV比READ支持的内核版本更早
+	sqe->fd = fd;
+	sqe->off = slot.offset + slot.filled;
+	sqe->addr = (unsigned long long)(unsigned long)&iov;
+	sqe->len = 1;
+	sqe->user_data = index;
+	ring->sqArray[pos] = pos;
+	__atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+	if (IoUringEnter(ring->fd, 1, 0, 0) < 0)
+	{
+		/* 提交失败：撤回，按读取错误处理 */
+		__atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
+		slot.error = errno ? errno : EIO;
+		slot.state = SLOT_DONE;
+	}
+#endif
+}
+
+/* 处理完成的读取，wait为true时至少等待一个完成 */
+void H264AsyncReader::UringReap(bool wait)
+{
+#ifdef EASY_H264_HAVE_IO_URING
+	unsigned head = *ring->cqHead;
+	if (wait && head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+		IoUringEnter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+
+	unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+	while (head != tail)
+	{
+		struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+		int index = (int)cqe->user_data;
+		int res = cqe->res;
+		head++;
+		__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+
+		Slot &slot = slots[index];
+		if (res == -EINTR || res == -EAGAIN)
+			UringSubmit(index);
+		else if (res < 0)
+		{
+			slot.error = -res;
+			slot.state = SLOT_DONE;
+		}
+		else
+		{
+			/* 短读时继续读取剩余部分，读满或读到文件末尾才算完成 */
+			slot.filled += res;
+			if (res == 0 || slot.filled >= chunkSize)
+				slot.state = SLOT_DONE;
+			else
+				UringSubmit(index);
+		}
+	}
+#endif
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 线程+pread
+void H264AsyncReader::ThreadRead(Slot &slot)
+{
+	while (slot.filled < chunkSize)
+	{
+		ssize_t n = pread(fd, slot.base + headroom + slot.filled, chunkSize - slot.filled, slot.offset + slot.filled);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+		{
+			slot.error = errno;
+			break;
+		}
+		if (n == 0)
+			break;
+		slot.filled += n;
+	}
+}
+
+void H264AsyncReader::ThreadLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		requestCond.wait(lock, [this]() { return quit || !requests.empty(); });
+		if (requests.empty())
+			return;
+
+		int index = requests.front();
+		requests.pop_front();
+		lock.unlock();
+		ThreadRead(slots[index]);
+		lock.lock();
+		slots[index].state = SLOT_DONE;
+		doneCond.notify_all();
+	}
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 异步预读
+H264AsyncReader::H264AsyncReader(int fd, int chunkSize, int depth, int headroom, H264Allocator *allocator, bool useUring)
+{
+	this->fd = fd;
+	this->chunkSize = chunkSize > 0 ? chunkSize : ASYNC_READ_CHUNK_SIZE;
+	this->headroom = headroom > 0 ? headroom : 0;
+	this->allocator = allocator ? allocator : GetDefaultAllocator();
+	readOffset = 0;
+	submitSeq = 0;
+	acquireSeq = 0;
+	eof = false;
+	ring = NULL;
+	quit = false;
+
+	slots.resize(depth >= 2 ? depth : 2);
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		memset(&slots[i], 0, sizeof(Slot));
+		slots[i].base = (unsigned char *)this->allocator->Alloc(this->headroom + this->chunkSize);
+		H264_STAT_ADD(H264_STAT_ALLOCS, 1);
+		H264_STAT_ADD(H264_STAT_ALLOC_BYTES, this->headroom + this->chunkSize);
+		slots[i].state = SLOT_FREE;
+	}
+
+	if (!useUring || !UringInit())
+		worker = std::thread(&H264AsyncReader::ThreadLoop, this);
+	Submit();
+}
+
+H264AsyncReader::~H264AsyncReader()
+{
+	Drain();
+	if (ring)
+		UringFree(ring);
+	ring = NULL;
+
+	if (worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		requestCond.notify_all();
+		worker.join();
+	}
+
+	for (size_t i = 0; i < slots.size(); i++)
+		allocator->Free(slots[i].base, headroom + chunkSize);
+}
+
+/* 所有空闲的缓冲区都提交读取 */
+void H264AsyncReader::Submit()
+{
+	if (eof)
+		return;
+
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		Slot &slot = slots[i];
+		if (slot.state != SLOT_FREE)
+			continue;
+
+		slot.offset = readOffset;
+		slot.seq = submitSeq++;
+		slot.filled = 0;
+		slot.error = 0;
+		readOffset += chunkSize;
+
+		if (ring)
+		{
+			slot.state = SLOT_PENDING;
+			UringSubmit(i);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slot.state = SLOT_PENDING;
+			requests.push_back(i);
+			requestCond.notify_one();
+		}
+	}
+}
+
+/* 等待所有正在进行的读取完成 */
+void H264AsyncReader::Drain()
+{
+	if (ring)
+	{
+		while (true)
+		{
+			bool pending = false;
+			for (size_t i = 0; i < slots.size(); i++)
+				pending = pending || slots[i].state == SLOT_PENDING;
+			if (!pending)
+				break;
+			UringReap(true);
+		}
+	}
+	else
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCond.wait(lock, [this]() {
+			for (size_t i = 0; i < slots.size(); i++)
+			{
+				if (slots[i].state == SLOT_PENDING)
+					return false;
+			}
+			return true;
+		});
+	}
+}
+
+int H264AsyncReader::Acquire(unsigned char *&data)
+{
+	if (eof)
+		return 0;
+
+	Slot *slot = NULL;
+	{
+		std::lock_guard<std::mutex> lock(mutex); // 线程方式下state可能正被修改
+		for (size_t i = 0; i < slots.size() && !slot; i++)
+		{
+			if (slots[i].seq == acquireSeq && (slots[i].state == SLOT_PENDING || slots[i].state == SLOT_DONE))
+				slot = &slots[i];
+		}
+	}
+	if (!slot)
+		return 0; // 缓冲区都未归还，无法读取
+
+	/* 等待本块读取完成，同时后面的块继续读取 */
+	if (ring)
+	{
+		while (slot->state != SLOT_DONE)
+			UringReap(true);
+	}
+	else
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCond.wait(lock, [slot]() { return slot->state == SLOT_DONE; });
+	}
+	acquireSeq++;
+
+	/* 读取错误或读到文件末尾后不再提交，后面已提交的块丢弃 */
+	if (slot->error || slot->filled < chunkSize)
+		eof = true;
+	if (slot->error || slot->filled == 0)
+	{
+		slot->state = SLOT_FREE;
+		return slot->error ? -1 : 0;
+	}
+
+	slot->state = SLOT_HELD;
+	data = slot->base + headroom;
+	return slot->filled;
+}
+
+void H264AsyncReader::Release(unsigned char *data)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < slots.size(); i++)
+		{
+			if (slots[i].state == SLOT_HELD && slots[i].base + headroom == data)
+			{
+				slots[i].state = SLOT_FREE;
+				break;
+			}
+		}
+	}
+	Submit();
+}
+
+void H264AsyncReader::Seek(unsigned long long offset)
+{
+	Drain();
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		if (slots[i].state == SLOT_DONE)
+			slots[i].state = SLOT_FREE;
+	}
+	readOffset = offset;
+	acquireSeq = submitSeq;
+	eof = false;
+	Submit();
+}
+
@@ -0,0 +1,101 @@
+/*
+ * 异步预读：io_uring(不可用时退回线程+pread)，多个缓冲区轮流读取，解析当前块时后面的块已在读取
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_AIO_H__
+#define __FREE_EASY_H264_AIO_H__
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include "easy_h264_alloc.h"
+
+#define ASYNC_READ_CHUNK_SIZE (1024*1024) // 每块读取的大小
+#define ASYNC_READ_DEPTH 3 // 缓冲区个数：1个解析中，其余在读取
+
+struct AioRing;
+
+/*
+ * 按文件顺序分块读取，Acquire取出已读完的块后立即提交后面的读取
+ * 只能由一个线程使用；fd由调用者管理，在对象析构前必须有效
+ */
+class H264AsyncReader
+{
+public:
+	/*
+	 * headroom：每块数据之前预留的字节数，调用者可以把上一块剩余的数据拷贝到这里，与本块拼成连续的数据
+	 * useUring为false时直接使用线程+pread
+	 */
+	H264AsyncReader(int fd, int chunkSize = ASYNC_READ_CHUNK_SIZE, int depth = ASYNC_READ_DEPTH,
+		int headroom = 0, H264Allocator *allocator = NULL, bool useUring = true);
+	~H264AsyncReader();
+
+	/*
+	 * 取出下一块，返回数据长度，0表示文件结束，-1表示读取错误
+	 * data之前有headroom字节可用，在Release之前有效
+	 */
+	int Acquire(unsigned char *&data);
+
+	/* 归还Acquire取出的块，缓冲区用于后面的读取 */
+	void Release(unsigned char *data);
+
+	/* 从offset处重新开始读取，正在进行的读取作废，已取出未归还的块仍然有效 */
+	void Seek(unsigned long long offset);
+
+	/* 是否使用了io_uring */
+	bool IsUring()
+	{
+		return ring != NULL;
+	}
+
+	H264AsyncReader(const H264AsyncReader &b) = delete;
+	H264AsyncReader &operator=(const H264AsyncReader &b) = delete;
+
+private:
+	enum { SLOT_FREE, SLOT_PENDING, SLOT_DONE, SLOT_HELD };
+
+	typedef struct Slot
+	{
+		unsigned char *base; // headroom + chunkSize
+		unsigned long long offset; // 本块在文件中的位置
+		unsigned long long seq; // 提交顺序，按此顺序取出
+		int filled; // 已读取的字节数
+		int error;
+		int state;
+	}Slot;
+
+	void Submit();
+	void Drain();
+
+	bool UringInit();
+	void UringSubmit(int index);
+	void UringReap(bool wait);
+
+	void ThreadLoop();
+	void ThreadRead(Slot &slot);
+
+	int fd;
+	int chunkSize;
+	int headroom;
+	H264Allocator *allocator;
+	std::vector<Slot> slots;
+	unsigned long long readOffset; // 下一次提交的读取位置
+	unsigned long long submitSeq; // 下一次提交的序号
+	unsigned long long acquireSeq; // 下一次取出的序号
+	bool eof; // 已读到文件末尾，不再提交
+
+	AioRing *ring; // io_uring，NULL表示使用线程
+
+	std::thread worker; // 线程方式：按提交顺序依次pread
+	std::mutex mutex;
+	std::condition_variable requestCond;
+	std::condition_variable doneCond;
+	std::deque<int> requests;
+	bool quit;
+};
+
+#endif
+
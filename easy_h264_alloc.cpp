@@ -0,0 +1,185 @@
+/*
+ * H264解析器内存分配实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include <new>
+#include "easy_h264_alloc.h"
+#include "easy_h264_stats.h"
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 默认分配器
+class H264DefaultAllocator : public H264Allocator
+{
+public:
+	void *Alloc(size_t size)
+	{
+		return new unsigned char[size ? size : 1];
+	}
+
+	void Free(void *p, size_t)
+	{
+		delete[] (unsigned char *)p;
+	}
+};
+
+H264Allocator *GetDefaultAllocator()
+{
+	static H264DefaultAllocator allocator;
+	return &allocator;
+}
+
+H264Allocator *GetSharedSlabPool()
+{
+	static H264SlabPool pool;
+	return &pool;
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// slab内存池
+/* 返回size所属的级别，超过最大级别时返回-1 */
+static int SizeClass(size_t size, int minShift, int maxShift)
+{
+	int shift = minShift;
+	while (shift <= maxShift && ((size_t)1 << shift) < size)
+		shift++;
+	return shift <= maxShift ? shift - minShift : -1;
+}
+
+H264SlabPool::H264SlabPool(size_t maxCached)
+{
+	for (int i = 0; i < CLASS_COUNT; i++)
+		freeList[i] = NULL;
+	this->maxCached = maxCached;
+	cachedBytes = 0;
+	systemAllocCount = 0;
+}
+
+H264SlabPool::~H264SlabPool()
+{
+	Trim();
+}
+
+size_t H264SlabPool::GetAllocSize(size_t size)
+{
+	int cls = SizeClass(size, MIN_SHIFT, MAX_SHIFT);
+	return cls >= 0 ? ((size_t)1 << (cls + MIN_SHIFT)) : size;
+}
+
+void *H264SlabPool::Alloc(size_t size)
+{
+	int cls = SizeClass(size, MIN_SHIFT, MAX_SHIFT);
+	if (cls >= 0)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		void *p = freeList[cls];
+		if (p)
+		{
+			memcpy(&freeList[cls], p, sizeof(void *));
+			cachedBytes -= (size_t)1 << (cls + MIN_SHIFT);
+			return p;
+		}
+		systemAllocCount++;
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		systemAllocCount++;
+	}
+	return ::operator new(GetAllocSize(size));
+}
+
+void H264SlabPool::Free(void *p, size_t size)
+{
+	if (!p)
+		return;
+
+	int cls = SizeClass(size, MIN_SHIFT, MAX_SHIFT);
+	if (cls >= 0)
+	{
+		size_t blockSize = (size_t)1 << (cls + MIN_SHIFT);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (cachedBytes + blockSize <= maxCached)
+		{
+			memcpy(p, &freeList[cls], sizeof(void *));
+			freeList[cls] = p;
+			cachedBytes += blockSize;
+			return;
+		}
+	}
+	::operator delete(p);
+}
+
+void H264SlabPool::Trim()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int i = 0; i < CLASS_COUNT; i++)
+	{
+		while (freeList[i])
+		{
+			void *p = freeList[i];
+			memcpy(&freeList[i], p, sizeof(void *));
+			::operator delete(p);
+		}
+	}
+	cachedBytes = 0;
+}
+
+unsigned long long H264SlabPool::GetSystemAllocCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return systemAllocCount;
+}
+
+size_t H264SlabPool::GetCachedBytes()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return cachedBytes;
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 临时缓冲区
+ScratchBuffer::ScratchBuffer(H264Allocator *allocator)
+{
+	this->allocator = allocator ? allocator : GetDefaultAllocator();
+	data = NULL;
+	capacity = 0;
+}
+
+ScratchBuffer::~ScratchBuffer()
+{
+	Release();
+}
+
+unsigned char *ScratchBuffer::Grow(size_t size, size_t keep)
+{
+	if (size <= capacity)
+		return data;
+
+	/* 至少按2倍扩容，避免逐渐增大的输入反复分配 */
+	size_t want = capacity * 2 > size ? capacity * 2 : size;
+	want = allocator->GetAllocSize(want);
+	unsigned char *buf = (unsigned char *)allocator->Alloc(want);
+	H264_STAT_ADD(H264_STAT_ALLOCS, 1);
+	H264_STAT_ADD(H264_STAT_ALLOC_BYTES, want);
+	if (keep > capacity)
+		keep = capacity;
+	if (keep > 0)
+		memcpy(buf, data, keep);
+	H264_STAT_ADD(H264_STAT_MOVE_BYTES, keep);
+	Release();
+	data = buf;
+	capacity = want;
+	return data;
+}
+
+void ScratchBuffer::Release()
+{
+	if (data)
+		allocator->Free(data, capacity);
+	data = NULL;
+	capacity = 0;
+}
+
@@ -0,0 +1,114 @@
+/*
+ * H264解析器内存分配：可替换的分配器、解析器内部的临时缓冲区、多个解析器共享的slab内存池
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_ALLOC_H__
+#define __FREE_EASY_H264_ALLOC_H__
+#include <stddef.h>
+#include <mutex>
+
+// 分配器接口：解析器的大块缓冲区(数据拷贝、文件读取缓冲区、流缓存)通过它分配
+class H264Allocator
+{
+public:
+	virtual ~H264Allocator()
+	{}
+
+	/* 分配至少size字节，失败时抛出std::bad_alloc */
+	virtual void *Alloc(size_t size) = 0;
+
+	/* 释放，size与Alloc时相同(或者是GetAllocSize的返回值) */
+	virtual void Free(void *p, size_t size) = 0;
+
+	/* 申请size字节时实际能得到的大小，调用者可以直接使用这么多 */
+	virtual size_t GetAllocSize(size_t size)
+	{
+		return size;
+	}
+};
+
+/* 默认分配器：new[]/delete[] */
+H264Allocator *GetDefaultAllocator();
+
+/* 进程内共享的slab内存池，参见H264SlabPool */
+H264Allocator *GetSharedSlabPool();
+
+/*
+ * slab内存池：按2的幂大小(4KB~64MB)分级缓存释放的内存块，下次申请同一级别时直接复用
+ * 用于大量解析器实例频繁创建销毁的场景，线程安全；缓存总量超过maxCached时直接释放
+ */
+class H264SlabPool : public H264Allocator
+{
+public:
+	explicit H264SlabPool(size_t maxCached = 256 * 1024 * 1024);
+	~H264SlabPool();
+
+	void *Alloc(size_t size);
+	void Free(void *p, size_t size);
+	size_t GetAllocSize(size_t size);
+
+	/* 释放所有缓存的内存块 */
+	void Trim();
+
+	/* 向系统申请内存的次数、当前缓存的字节数 */
+	unsigned long long GetSystemAllocCount();
+	size_t GetCachedBytes();
+
+	H264SlabPool(const H264SlabPool &b) = delete;
+	H264SlabPool &operator=(const H264SlabPool &b) = delete;
+
+private:
+	enum { MIN_SHIFT = 12, MAX_SHIFT = 26, CLASS_COUNT = MAX_SHIFT - MIN_SHIFT + 1 };
+
+	std::mutex mutex;
+	void *freeList[CLASS_COUNT]; // 空闲块链表，块的前几个字节保存下一块的地址
+	size_t maxCached;
+	size_t cachedBytes;
+	unsigned long long systemAllocCount;
+};
+
+/*
+ * 解析器内部的临时缓冲区：容量只增不减，在多次解析之间重复使用，稳定后不再分配内存
+ * allocator为NULL时使用默认分配器
+ */
+class ScratchBuffer
+{
+public:
+	explicit ScratchBuffer(H264Allocator *allocator = NULL);
+	~ScratchBuffer();
+
+	/* 保证容量至少为size，原有数据不保留 */
+	unsigned char *Reserve(size_t size)
+	{
+		return Grow(size, 0);
+	}
+
+	/* 保证容量至少为size，保留前keep个字节 */
+	unsigned char *Grow(size_t size, size_t keep);
+
+	/* 释放内存 */
+	void Release();
+
+	unsigned char *GetData()
+	{
+		return data;
+	}
+
+	size_t GetCapacity()
+	{
+		return capacity;
+	}
+
+	ScratchBuffer(const ScratchBuffer &b) = delete;
+	ScratchBuffer &operator=(const ScratchBuffer &b) = delete;
+
+private:
+	H264Allocator *allocator;
+	unsigned char *data;
+	size_t capacity;
+};
+
+#endif
+
@@ -0,0 +1,396 @@
+/*
+ * AVCC与Annex B互相转换实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include "easy_h264_avcc.h"
+
+static const unsigned char startCode4[4] = { 0, 0, 0, 1 };
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// avcC解析及生成
+/* 读取2字节长度及其后的NALU */
+static bool ReadNaluArray(const unsigned char *data, int len, int &pos, int count, std::vector<Nalu> &out)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (pos + 2 > len)
+			return false;
+		int size = (data[pos] << 8) | data[pos + 1];
+		pos += 2;
+		if (pos + size > len)
+			return false;
+		Nalu nalu;
+		nalu.SetData(const_cast<unsigned char *>(data + pos), size);
+		out.push_back(nalu);
+		pos += size;
+	}
+	return true;
+}
+
+/* 这些profile的avcC在PPS之后有chroma_format等扩展字段 */
+static bool IsHighProfile(int profile_idc)
+{
+	return profile_idc == 100 || profile_idc == 110 || profile_idc == 122 || profile_idc == 144;
+}
+
+bool ParseAvcC(const unsigned char *data, int len, AvccConfig &cfg)
+{
+	cfg.Reset();
+	if (!data || len < 7 || data[0] != 1)
+		return false;
+
+	cfg.configuration_version = data[0];
+	cfg.profile_idc = data[1];
+	cfg.profile_compatibility = data[2];
+	cfg.level_idc = data[3];
+	cfg.length_size = (data[4] & 0x03) + 1;
+
+	int pos = 5;
+	if (!ReadNaluArray(data, len, ++pos, data[5] & 0x1f, cfg.sps))
+		return false;
+	if (pos >= len)
+		return false;
+	int ppsCount = data[pos];
+	if (!ReadNaluArray(data, len, ++pos, ppsCount, cfg.pps))
+		return false;
+
+	/* 扩展字段：很多编码器不写，不存在或不完整时忽略 */
+	if (IsHighProfile(cfg.profile_idc) && pos + 4 <= len)
+	{
+		std::vector<Nalu> ext;
+		int extPos = pos + 4;
+		if (ReadNaluArray(data, len, extPos, data[pos + 3], ext))
+		{
+			cfg.has_ext = true;
+			cfg.chroma_format = data[pos] & 0x03;
+			cfg.bit_depth_luma_minus8 = data[pos + 1] & 0x07;
+			cfg.bit_depth_chroma_minus8 = data[pos + 2] & 0x07;
+			cfg.sps_ext.swap(ext);
+		}
+	}
+	return true;
+}
+
+int BuildAvcC(const Nalu *sps, int spsCount, const Nalu *pps, int ppsCount, int lengthSize,
+	unsigned char *out, int size)
+{
+	if (!sps || !pps || spsCount <= 0 || spsCount > AVCC_MAX_SPS || ppsCount <= 0 || ppsCount > AVCC_MAX_PPS
+		|| (lengthSize != 1 && lengthSize != 2 && lengthSize != 4) || !sps[0].pdata || sps[0].length < 4)
+		return -1;
+
+	int profile_idc = sps[0].pdata[1];
+	bool high = IsHighProfile(profile_idc);
+	int need = 6 + 1 + (high ? 4 : 0);
+	for (int i = 0; i < spsCount; i++)
+		need += 2 + sps[i].length;
+	for (int i = 0; i < ppsCount; i++)
+		need += 2 + pps[i].length;
+	if (!out)
+		return need;
+	if (size < need)
+		return -1;
+
+	unsigned char *q = out;
+	*q++ = 1;
+	*q++ = sps[0].pdata[1]; // profile_idc
+	*q++ = sps[0].pdata[2]; // constraint_set_flag
+	*q++ = sps[0].pdata[3]; // level_idc
+	*q++ = 0xfc | (lengthSize - 1);
+	*q++ = 0xe0 | spsCount;
+	for (int i = 0; i < spsCount; i++)
+	{
+		*q++ = (sps[i].length >> 8) & 0xff;
+		*q++ = sps[i].length & 0xff;
+		memcpy(q, sps[i].pdata, sps[i].length);
+		q += sps[i].length;
+	}
+	*q++ = ppsCount;
+	for (int i = 0; i < ppsCount; i++)
+	{
+		*q++ = (pps[i].length >> 8) & 0xff;
+		*q++ = pps[i].length & 0xff;
+		memcpy(q, pps[i].pdata, pps[i].length);
+		q += pps[i].length;
+	}
+
+	if (high)
+	{
+		/* 扩展字段的取值来自SPS */
+		SpsInfo info;
+		ParseSps(sps[0].pdata, sps[0].length, info);
+		*q++ = 0xfc | (info.chroma_format_idc & 0x03);
+		*q++ = 0xf8 | (info.bit_depth_luma_minus8 & 0x07);
+		*q++ = 0xf8 | (info.bit_depth_chroma_minus8 & 0x07);
+		*q++ = 0; // numOfSequenceParameterSetExt
+	}
+	return q - out;
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// AVCC转Annex B
+AvccNaluIterator::AvccNaluIterator(const unsigned char *data, int len, int lengthSize)
+{
+	p = data;
+	end = (data && len > 0) ? data + len : data;
+	this->lengthSize = lengthSize;
+	error = !data || lengthSize < 1 || lengthSize > 4;
+}
+
+bool AvccNaluIterator::Next(Nalu &nalu)
+{
+	while (!error && p < end)
+	{
+		if (end - p < lengthSize)
+		{
+			error = true;
+			return false;
+		}
+		unsigned int size = 0;
+		for (int i = 0; i < lengthSize; i++)
+			size = (size << 8) | *p++;
+		if (size > (unsigned int)(end - p))
+		{
+			error = true;
+			return false;
+		}
+		if (size == 0)
+			continue;
+		nalu.SetData(const_cast<unsigned char *>(p), size);
+		p += size;
+		return true;
+	}
+	return false;
+}
+
+/*
+ * 按输出顺序产生Annex B的各个片段(起始码、NALU)，写入缓冲区或iovec共用
+ * 需要时在第一个IDR之前插入cfg中的SPS/PPS，格式错误时返回false
+ */
+template <typename F>
+static bool ForEachAnnexBPiece(const unsigned char *data, int len, int lengthSize, const AvccConfig *cfg, F emit)
+{
+	AvccNaluIterator it(data, len, lengthSize);
+	Nalu nalu;
+	bool hasSps = false, hasPps = false, inserted = false;
+	while (it.Next(nalu))
+	{
+		int type = nalu.GetNaluType();
+		if (type == NALU_TYPE_SPS)
+			hasSps = true;
+		else if (type == NALU_TYPE_PPS)
+			hasPps = true;
+		else if (type == NALU_TYPE_IDR && cfg && !inserted && (!hasSps || !hasPps))
+		{
+			/* 样本中已有的一种参数集不再插入，避免重复或被avcC中不同的版本覆盖 */
+			for (size_t i = 0; !hasSps && i < cfg->sps.size(); i++)
+			{
+				if (!emit(startCode4, 4) || !emit(cfg->sps[i].pdata, cfg->sps[i].length))
+					return false;
+			}
+			for (size_t i = 0; !hasPps && i < cfg->pps.size(); i++)
+			{
+				if (!emit(startCode4, 4) || !emit(cfg->pps[i].pdata, cfg->pps[i].length))
+					return false;
+			}
+			inserted = true;
+		}
+		if (type == NALU_TYPE_IDR)
+			inserted = true; // 只在第一个IDR之前插入
+
+		if (!emit(startCode4, 4) || !emit(nalu.GetData(), nalu.GetLength()))
+			return false;
+	}
+	return !it.IsError();
+}
+
+int AvccToAnnexB(const unsigned char *data, int len, int lengthSize, unsigned char *out, int size,
+	const AvccConfig *cfg)
+{
+	long long need = 0;
+	bool ok = ForEachAnnexBPiece(data, len, lengthSize, cfg, [&need](const unsigned char *, int n) {
+		need += n;
+		return true;
+	});
+	if (!ok || need > 0x7fffffff)
+		return -1;
+	if (!out)
+		return (int)need;
+	if (size < need)
+		return -1;
+
+	unsigned char *q = out;
+	ForEachAnnexBPiece(data, len, lengthSize, cfg, [&q](const unsigned char *p, int n) {
+		memcpy(q, p, n);
+		q += n;
+		return true;
+	});
+	return q - out;
+}
+
+int AvccToAnnexBIov(const unsigned char *data, int len, int lengthSize, struct iovec *iov, int iovMax,
+	const AvccConfig *cfg)
+{
+	if (!iov)
+		return -1;
+	int count = 0;
+	bool ok = ForEachAnnexBPiece(data, len, lengthSize, cfg, [&](const unsigned char *p, int n) {
+		if (count >= iovMax)
+			return false;
+		iov[count].iov_base = const_cast<unsigned char *>(p);
+		iov[count].iov_len = n;
+		count++;
+		return true;
+	});
+	return ok ? count : -1;
+}
+
+int AvccToAnnexBInPlace(unsigned char *data, int len, int lengthSize)
+{
+	if (lengthSize != 3 && lengthSize != 4)
+		return -1;
+
+	/* 先检查格式，出错时不修改数据 */
+	AvccNaluIterator check(data, len, lengthSize);
+	Nalu nalu;
+	while (check.Next(nalu));
+	if (check.IsError())
+		return -1;
+
+	/* 长度字段(包括长度为0的)替换为同样长度的起始码 */
+	int count = 0;
+	unsigned char *p = data, *end = data + len;
+	while (p < end)
+	{
+		unsigned int size = 0;
+		for (int i = 0; i < lengthSize; i++)
+			size = (size << 8) | p[i];
+		memcpy(p, startCode4 + 4 - lengthSize, lengthSize);
+		p += lengthSize + size;
+		count += size > 0;
+	}
+	return count;
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Annex B转AVCC
+/*
+ * 从p开始取出下一个NALU，p移动到再下一个起始码(或末尾)
+ * nalu不含起始码，NALU不会以0x00结尾，末尾的0是trailing_zero_8bits，去掉
+ */
+static bool NextAnnexBNalu(const unsigned char *&p, const unsigned char *end, const unsigned char *&nalu, int &naluLen)
+{
+	int startCodeLen = 0;
+	const unsigned char *s = FindStartCode(p, end, &startCodeLen);
+	if (!s)
+	{
+		p = end;
+		return false;
+	}
+	nalu = s + startCodeLen;
+	const unsigned char *next = FindStartCode(nalu, end, &startCodeLen);
+	const unsigned char *e = next ? next : end;
+	while (e > nalu && e[-1] == 0)
+		e--;
+	naluLen = e - nalu;
+	p = next ? next : end;
+	return true;
+}
+
+/* 是否需要输出该NALU */
+static bool KeepNalu(const unsigned char *nalu, int naluLen, bool dropParamSets)
+{
+	if (naluLen <= 0)
+		return false;
+	int type = nalu[0] & 0x1f;
+	return !dropParamSets || (type != NALU_TYPE_SPS && type != NALU_TYPE_PPS && type != NALU_TYPE_AUD);
+}
+
+/* 长度是否能用lengthSize个字节表示 */
+static bool FitLength(int naluLen, int lengthSize)
+{
+	return lengthSize >= 4 || naluLen < (1 << (8 * lengthSize));
+}
+
+static void PutLength(unsigned char *q, int naluLen, int lengthSize)
+{
+	for (int i = lengthSize - 1; i >= 0; i--)
+	{
+		q[i] = naluLen & 0xff;
+		naluLen >>= 8;
+	}
+}
+
+int AnnexBToAvcc(const unsigned char *data, int len, int lengthSize, unsigned char *out, int size,
+	bool dropParamSets)
+{
+	if (!data || len <= 0 || lengthSize < 1 || lengthSize > 4)
+		return -1;
+
+	const unsigned char *end = data + len;
+	const unsigned char *p = data, *nalu = NULL;
+	int naluLen = 0;
+	long long need = 0;
+	while (NextAnnexBNalu(p, end, nalu, naluLen))
+	{
+		if (!KeepNalu(nalu, naluLen, dropParamSets))
+			continue;
+		if (!FitLength(naluLen, lengthSize))
+			return -1;
+		need += lengthSize + naluLen;
+	}
+	if (need > 0x7fffffff)
+		return -1;
+	if (!out)
+		return (int)need;
+	if (size < need)
+		return -1;
+
+	unsigned char *q = out;
+	p = data;
+	while (NextAnnexBNalu(p, end, nalu, naluLen))
+	{
+		if (!KeepNalu(nalu, naluLen, dropParamSets))
+			continue;
+		PutLength(q, naluLen, lengthSize);
+		memcpy(q + lengthSize, nalu, naluLen);
+		q += lengthSize + naluLen;
+	}
+	return q - out;
+}
+
+int AnnexBToAvccInPlace(unsigned char *data, int len, int lengthSize, bool dropParamSets)
+{
+	if (!data || len <= 0 || lengthSize < 1 || lengthSize > 4)
+		return -1;
+
+	/* 第一遍：检查写入位置始终不超过NALU数据的起始位置，即长度字段不会覆盖还没有移动的数据 */
+	const unsigned char *end = data + len;
+	const unsigned char *p = data, *nalu = NULL;
+	int naluLen = 0;
+	long long w = 0;
+	while (NextAnnexBNalu(p, end, nalu, naluLen))
+	{
+		if (!KeepNalu(nalu, naluLen, dropParamSets))
+			continue;
+		if (!FitLength(naluLen, lengthSize) || w + lengthSize > nalu - data)
+			return -1;
+		w += lengthSize + naluLen;
+	}
+
+	/* 第二遍：向前移动，写入的数据都在下一个起始码之前，不影响后面的查找 */
+	unsigned char *q = data;
+	p = data;
+	while (NextAnnexBNalu(p, end, nalu, naluLen))
+	{
+		if (!KeepNalu(nalu, naluLen, dropParamSets))
+			continue;
+		PutLength(q, naluLen, lengthSize);
+		memmove(q + lengthSize, nalu, naluLen);
+		q += lengthSize + naluLen;
+	}
+	return q - data;
+}
+
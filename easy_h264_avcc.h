@@ -0,0 +1,115 @@
+/*
+ * AVCC(MP4/FLV中长度前缀格式)与Annex B(起始码格式)互相转换，avcC配置解析及生成
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_AVCC_H__
+#define __FREE_EASY_H264_AVCC_H__
+#include <sys/uio.h>
+#include "easy_h264_parser.h"
+
+#define AVCC_MAX_SPS 31 // numOfSequenceParameterSets为5位
+#define AVCC_MAX_PPS 255
+
+// avcC(AVCDecoderConfigurationRecord)：SPS/PPS为零拷贝视图，指向解析时的数据
+typedef struct AvccConfig
+{
+	AvccConfig()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		configuration_version = 0;
+		profile_idc = profile_compatibility = level_idc = 0;
+		length_size = 4;
+		sps.clear();
+		pps.clear();
+		has_ext = false;
+		chroma_format = 1;
+		bit_depth_luma_minus8 = bit_depth_chroma_minus8 = 0;
+		sps_ext.clear();
+	}
+
+	int configuration_version;                    // 固定为1
+	int profile_idc;                              // AVCProfileIndication
+	int profile_compatibility;
+	int level_idc;                                // AVCLevelIndication
+	int length_size;                              // lengthSizeMinusOne + 1，NALU长度字段的字节数
+	std::vector<Nalu> sps;
+	std::vector<Nalu> pps;
+	bool has_ext;                                 // High profile扩展字段是否存在
+	int chroma_format;
+	int bit_depth_luma_minus8;
+	int bit_depth_chroma_minus8;
+	std::vector<Nalu> sps_ext;
+}AvccConfig;
+
+/* 解析avcC，cfg中的NALU指向data，data在cfg使用期间必须有效；成功返回true */
+bool ParseAvcC(const unsigned char *data, int len, AvccConfig &cfg);
+
+/*
+ * 根据SPS/PPS(不含起始码)生成avcC，lengthSize为1、2或4
+ * out为NULL时返回需要的大小；成功返回写入的字节数，参数错误或size不够时返回-1
+ */
+int BuildAvcC(const Nalu *sps, int spsCount, const Nalu *pps, int ppsCount, int lengthSize,
+	unsigned char *out, int size);
+
+// 逐个取出AVCC数据中的NALU，零拷贝
+class AvccNaluIterator
+{
+public:
+	AvccNaluIterator(const unsigned char *data, int len, int lengthSize);
+
+	/* 取出下一个NALU，结束或格式错误时返回false，长度为0的NALU跳过 */
+	bool Next(Nalu &nalu);
+
+	/* 长度字段超出数据范围等格式错误 */
+	bool IsError()
+	{
+		return error;
+	}
+
+private:
+	const unsigned char *p;
+	const unsigned char *end;
+	int lengthSize;
+	bool error;
+};
+
+/*
+ * AVCC转Annex B，每个NALU前加4字节起始码
+ * cfg不为NULL时，如果IDR之前没有SPS/PPS，在第一个IDR之前插入cfg中的SPS/PPS
+ * out为NULL时返回需要的大小；成功返回写入的字节数，格式错误或size不够时返回-1
+ */
+int AvccToAnnexB(const unsigned char *data, int len, int lengthSize, unsigned char *out, int size,
+	const AvccConfig *cfg = 0);
+
+/*
+ * 同上，但不拷贝数据：输出为iovec数组，起始码指向静态数据，NALU指向data(以及cfg)，可以直接用writev发送
+ * 返回使用的iovec个数，格式错误或iovMax不够时返回-1
+ */
+int AvccToAnnexBIov(const unsigned char *data, int len, int lengthSize, struct iovec *iov, int iovMax,
+	const AvccConfig *cfg = 0);
+
+/* AVCC原地转Annex B：lengthSize为4(或3)时长度字段直接替换为等长的起始码，返回NALU个数，格式错误或lengthSize不支持时返回-1 */
+int AvccToAnnexBInPlace(unsigned char *data, int len, int lengthSize);
+
+/*
+ * Annex B转AVCC，起始码之前的数据以及NALU末尾的trailing_zero_8bits丢弃
+ * dropParamSets为true时去掉SPS/PPS/AUD(它们通常放在avcC中)
+ * out为NULL时返回需要的大小；成功返回写入的字节数，size不够或NALU长度超出lengthSize的范围时返回-1
+ */
+int AnnexBToAvcc(const unsigned char *data, int len, int lengthSize, unsigned char *out, int size,
+	bool dropParamSets = false);
+
+/*
+ * Annex B原地转AVCC：长度字段不会覆盖还没有移动的数据时(如全部为4字节起始码且lengthSize为4)才能原地转换，
+ * 成功返回转换后的长度；不能原地转换时返回-1，data不做任何修改
+ */
+int AnnexBToAvccInPlace(unsigned char *data, int len, int lengthSize, bool dropParamSets = false);
+
+#endif
+
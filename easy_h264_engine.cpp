@@ -0,0 +1,302 @@
+/*
+ * H264多路流解析引擎实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include "easy_h264_engine.h"
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 单生产者单消费者队列
+SpscByteQueue::SpscByteQueue(int capacity)
+{
+	size_t size = 4096;
+	while ((int)size < capacity)
+		size <<= 1;
+	this->capacity = size;
+	mask = size - 1;
+	buffer = new unsigned char[size];
+	head.store(0, std::memory_order_relaxed);
+	tail.store(0, std::memory_order_relaxed);
+}
+
+SpscByteQueue::~SpscByteQueue()
+{
+	delete[] buffer;
+}
+
+bool SpscByteQueue::Write(const unsigned char *data, int len)
+{
+	if (!data || len <= 0)
+		return len == 0;
+
+	size_t h = head.load(std::memory_order_relaxed);
+	size_t t = tail.load(std::memory_order_acquire); // 消费者释放的空间
+	if (capacity - (h - t) < (size_t)len)
+		return false;
+
+	/* 环绕时分两次拷贝 */
+	size_t pos = h & mask;
+	size_t first = capacity - pos < (size_t)len ? capacity - pos : (size_t)len;
+	memcpy(buffer + pos, data, first);
+	memcpy(buffer, data + first, len - first);
+	head.store(h + len, std::memory_order_release); // 数据写入后才对消费者可见
+	return true;
+}
+
+int SpscByteQueue::Peek(const unsigned char **data)
+{
+	size_t t = tail.load(std::memory_order_relaxed);
+	size_t h = head.load(std::memory_order_acquire);
+	if (h == t)
+		return 0;
+
+	size_t pos = t & mask;
+	size_t len = h - t;
+	if (len > capacity - pos)
+		len = capacity - pos;
+	*data = buffer + pos;
+	return (int)len;
+}
+
+void SpscByteQueue::Consume(int len)
+{
+	tail.store(tail.load(std::memory_order_relaxed) + len, std::memory_order_release);
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 多路流解析引擎
+struct H264StreamEngine::Stream
+{
+	Stream(int id, int worker, const EngineNaluCallback &callback, int queueSize)
+		: queue(queueSize),
+		parser([this](Nalu &nalu) { OnNalu(nalu); })
+	{
+		this->id = id;
+		this->worker = worker;
+		this->callback = callback;
+		scheduled.store(false);
+		busy.store(false);
+		flushHead.store(0);
+		flushTail.store(0);
+	}
+
+	/* 工作线程中调用：更新SPS/PPS缓存，解析slice头，然后回调 */
+	void OnNalu(Nalu &nalu)
+	{
+		int type = nalu.GetNaluType();
+		if (type == NALU_TYPE_SPS || type == NALU_TYPE_PPS)
+			cache.Update(nalu);
+
+		const SliceHeader *slice = NULL;
+		if (type == NALU_TYPE_SLICE || type == NALU_TYPE_DPA || type == NALU_TYPE_IDR)
+		{
+			ParseSliceHeader(nalu.GetData(), nalu.GetLength(), cache, sh, SLICE_PARSE_FRAME_NUM);
+			if (sh.parse_level >= SLICE_PARSE_TYPE)
+				slice = &sh;
+		}
+		if (callback)
+			callback(id, nalu, slice);
+	}
+
+	int id;
+	int worker;
+	EngineNaluCallback callback;
+	SpscByteQueue queue; // Push线程写入，工作线程读取
+	H264StreamParse parser;
+	ParamSetCache cache;
+	SliceHeader sh;
+	std::atomic<bool> scheduled; // 已加入工作线程的待处理列表
+	std::atomic<bool> busy; // 工作线程正在处理
+
+	/* Flush请求：记录请求时队列的写入位置，工作线程读到该位置时输出最后一帧(单生产者单消费者环形队列) */
+	size_t flushPos[ENGINE_FLUSH_SLOTS];
+	std::atomic<unsigned int> flushHead; // 只由Flush线程修改
+	std::atomic<unsigned int> flushTail; // 只由工作线程修改
+};
+
+struct H264StreamEngine::Worker
+{
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::vector<Stream *> ready; // 有数据待处理的流
+	bool stop = false;
+};
+
+H264StreamEngine::H264StreamEngine(int workers, int maxStreams)
+{
+	if (workers <= 0)
+		workers = std::thread::hardware_concurrency();
+	if (workers <= 0)
+		workers = 1;
+	if (maxStreams <= 0)
+		maxStreams = 1;
+
+	this->maxStreams = maxStreams;
+	streams = new Stream *[maxStreams];
+	streamCount.store(0);
+
+	workerCount = workers;
+	this->workers = new Worker[workers];
+	for (int i = 0; i < workers; i++)
+	{
+		Worker *w = &this->workers[i];
+		w->thread = std::thread(&H264StreamEngine::Run, this, w);
+	}
+}
+
+H264StreamEngine::~H264StreamEngine()
+{
+	for (int i = 0; i < workerCount; i++)
+	{
+		{
+			std::lock_guard<std::mutex> lock(workers[i].mutex);
+			workers[i].stop = true;
+		}
+		workers[i].cond.notify_one();
+	}
+	for (int i = 0; i < workerCount; i++)
+		workers[i].thread.join();
+	delete[] workers;
+
+	int count = streamCount.load();
+	for (int i = 0; i < count; i++)
+		delete streams[i];
+	delete[] streams;
+}
+
+int H264StreamEngine::AddStream(const EngineNaluCallback &callback, int queueSize)
+{
+	int id = streamCount.load(std::memory_order_relaxed);
+	if (id >= maxStreams)
+		return -1;
+	streams[id] = new Stream(id, id % workerCount, callback, queueSize); // 按顺序轮流分配给工作线程
+	streamCount.store(id + 1, std::memory_order_release);
+	return id;
+}
+
+/* 流从空闲变为待处理时才加锁通知工作线程，已在待处理列表中时Push不需要任何锁 */
+void H264StreamEngine::Schedule(Stream *s)
+{
+	if (s->scheduled.exchange(true, std::memory_order_acq_rel))
+		return;
+
+	Worker *w = &workers[s->worker];
+	{
+		std::lock_guard<std::mutex> lock(w->mutex);
+		w->ready.push_back(s);
+	}
+	w->cond.notify_one();
+}
+
+bool H264StreamEngine::Push(int stream, const unsigned char *data, int len)
+{
+	if (stream < 0 || stream >= GetStreamCount())
+		return false;
+
+	Stream *s = streams[stream];
+	if (!s->queue.Write(data, len))
+		return false;
+	Schedule(s);
+	return true;
+}
+
+bool H264StreamEngine::Flush(int stream)
+{
+	if (stream < 0 || stream >= GetStreamCount())
+		return false;
+
+	Stream *s = streams[stream];
+	unsigned int h = s->flushHead.load(std::memory_order_relaxed);
+	size_t pos = s->queue.GetWritePos();
+
+	/* 与上一个未处理的请求之间没有新数据时合并为一个 */
+	if (h != s->flushTail.load(std::memory_order_acquire) && s->flushPos[(h - 1) % ENGINE_FLUSH_SLOTS] == pos)
+	{
+		Schedule(s);
+		return true;
+	}
+	if (h - s->flushTail.load(std::memory_order_acquire) >= ENGINE_FLUSH_SLOTS)
+		return false;
+	s->flushPos[h % ENGINE_FLUSH_SLOTS] = pos;
+	s->flushHead.store(h + 1, std::memory_order_release);
+	Schedule(s);
+	return true;
+}
+
+/*
+ * 工作线程中处理一路流：先清除scheduled，之后的Push会重新调度，不会丢失数据
+ * 每次最多处理ENGINE_PROCESS_BUDGET字节，还有数据时重新加入待处理列表的末尾，
+ * 避免持续输入的流占住工作线程，使同一线程上的其它流得不到处理
+ */
+void H264StreamEngine::Process(Stream *s)
+{
+	s->busy.store(true, std::memory_order_relaxed);
+	s->scheduled.store(false, std::memory_order_seq_cst);
+
+	int budget = ENGINE_PROCESS_BUDGET;
+	while (budget > 0)
+	{
+		/* 读到最早的Flush请求的位置时输出最后一帧，之后的数据属于新的流 */
+		unsigned int t = s->flushTail.load(std::memory_order_relaxed);
+		bool flushPending = t != s->flushHead.load(std::memory_order_acquire);
+		size_t readPos = s->queue.GetReadPos();
+		if (flushPending && readPos == s->flushPos[t % ENGINE_FLUSH_SLOTS])
+		{
+			s->parser.Flush();
+			s->flushTail.store(t + 1, std::memory_order_release);
+			continue;
+		}
+
+		const unsigned char *data = NULL;
+		int len = s->queue.Peek(&data);
+		if (len <= 0)
+			break;
+		if (flushPending && (size_t)len > s->flushPos[t % ENGINE_FLUSH_SLOTS] - readPos)
+			len = (int)(s->flushPos[t % ENGINE_FLUSH_SLOTS] - readPos);
+		if (len > budget)
+			len = budget;
+		s->parser.Feed(data, len);
+		s->queue.Consume(len);
+		budget -= len;
+	}
+
+	bool more = s->queue.GetSize() > 0
+		|| s->flushTail.load(std::memory_order_relaxed) != s->flushHead.load(std::memory_order_acquire);
+	s->busy.store(false, std::memory_order_release);
+	if (more)
+		Schedule(s);
+}
+
+void H264StreamEngine::Run(Worker *w)
+{
+	std::vector<Stream *> ready;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(w->mutex);
+			w->cond.wait(lock, [w]() { return w->stop || !w->ready.empty(); });
+			if (w->stop)
+				return;
+			ready.swap(w->ready);
+		}
+		for (size_t i = 0; i < ready.size(); i++)
+			Process(ready[i]);
+		ready.clear();
+	}
+}
+
+void H264StreamEngine::WaitIdle()
+{
+	int count = GetStreamCount();
+	for (int i = 0; i < count; i++)
+	{
+		Stream *s = streams[i];
+		while (s->scheduled.load(std::memory_order_seq_cst) || s->busy.load(std::memory_order_acquire)
+			|| s->queue.GetSize() > 0 || s->flushTail.load(std::memory_order_acquire) != s->flushHead.load(std::memory_order_acquire))
+			std::this_thread::yield();
+	}
+}
+
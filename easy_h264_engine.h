@@ -0,0 +1,133 @@
+/*
+ * H264多路流解析引擎：固定数量的工作线程处理大量流
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_ENGINE_H__
+#define __FREE_EASY_H264_ENGINE_H__
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "easy_h264_slice.h"
+
+#define ENGINE_QUEUE_SIZE (1024*1024) // 每路流输入队列的默认大小
+#define ENGINE_FLUSH_SLOTS 16 // 每路流最多可以有多少个未处理的Flush请求
+#define ENGINE_PROCESS_BUDGET (256*1024) // 工作线程每次最多处理一路流的字节数，之后轮到同一线程上的其它流
+
+// 单生产者单消费者的无锁字节队列(环形缓冲区)
+class SpscByteQueue
+{
+public:
+	/* capacity向上取整为2的幂 */
+	explicit SpscByteQueue(int capacity);
+	~SpscByteQueue();
+
+	/* 生产者：写入全部数据，剩余空间不足时不写入并返回false */
+	bool Write(const unsigned char *data, int len);
+
+	/* 消费者：获取可读的连续数据(环绕时只返回到缓冲区末尾的部分)，返回长度，0表示队列为空 */
+	int Peek(const unsigned char **data);
+
+	/* 消费者：丢弃Peek得到的前len个字节 */
+	void Consume(int len);
+
+	/* 生产者：累计写入的字节数，即下一个写入位置 */
+	size_t GetWritePos()
+	{
+		return head.load(std::memory_order_relaxed);
+	}
+
+	/* 消费者：累计读取的字节数，即下一个读取位置 */
+	size_t GetReadPos()
+	{
+		return tail.load(std::memory_order_relaxed);
+	}
+
+	/* 当前数据量，只是近似值 */
+	int GetSize()
+	{
+		return (int)(head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire));
+	}
+
+	int GetCapacity()
+	{
+		return (int)capacity;
+	}
+
+	SpscByteQueue(const SpscByteQueue &b) = delete;
+	SpscByteQueue &operator=(const SpscByteQueue &b) = delete;
+
+private:
+	unsigned char *buffer;
+	size_t capacity;
+	size_t mask;
+	alignas(64) std::atomic<size_t> head; // 写入位置，只由生产者修改
+	alignas(64) std::atomic<size_t> tail; // 读取位置，只由消费者修改
+};
+
+/*
+ * 引擎回调：在工作线程中调用，nalu只在回调期间有效
+ * slice为slice头(解析到SLICE_PARSE_FRAME_NUM，缺少SPS/PPS时只有SLICE_PARSE_TYPE)，非slice的NALU为NULL
+ */
+typedef std::function<void(int stream, Nalu &nalu, const SliceHeader *slice)> EngineNaluCallback;
+
+/*
+ * 多路流解析引擎
+ * 每路流有自己的输入队列(SpscByteQueue)、H264StreamParse和SPS/PPS缓存，固定分配给一个工作线程，
+ * 因此同一路流的数据按输入顺序处理，回调也按顺序调用；工作线程数不随流的数量增加
+ * 每路流只能有一个线程调用Push/Flush，不同的流可以在不同的线程中输入
+ */
+class H264StreamEngine
+{
+public:
+	/* workers为0时使用CPU核数；maxStreams为最多可以添加的流数 */
+	explicit H264StreamEngine(int workers = 0, int maxStreams = 1024);
+	~H264StreamEngine();
+
+	/* 添加一路流，返回流的id，超过maxStreams时返回-1；不能与其它AddStream同时调用 */
+	int AddStream(const EngineNaluCallback &callback, int queueSize = ENGINE_QUEUE_SIZE);
+
+	/* 输入数据，队列剩余空间不足时返回false，数据没有写入，调用者可以稍后重试或丢弃 */
+	bool Push(int stream, const unsigned char *data, int len);
+
+	/*
+	 * 输入结束，工作线程处理完本次调用之前输入的数据后输出缓存中的最后一帧，之后Push的数据属于新的流
+	 * 未处理的Flush请求已有ENGINE_FLUSH_SLOTS个时返回false，调用者可以稍后重试
+	 */
+	bool Flush(int stream);
+
+	/* 等待所有已输入的数据处理完毕 */
+	void WaitIdle();
+
+	int GetWorkerCount()
+	{
+		return workerCount;
+	}
+
+	int GetStreamCount()
+	{
+		return streamCount.load(std::memory_order_acquire);
+	}
+
+	H264StreamEngine(const H264StreamEngine &b) = delete;
+	H264StreamEngine &operator=(const H264StreamEngine &b) = delete;
+
+private:
+	struct Stream;
+	struct Worker;
+
+	void Schedule(Stream *s);
+	void Process(Stream *s);
+	void Run(Worker *w);
+
+	int workerCount;
+	Worker *workers;
+	int maxStreams;
+	Stream **streams; // 预先分配maxStreams个位置，添加流时不需要移动，Push无需加锁
+	std::atomic<int> streamCount;
+};
+
+#endif
+
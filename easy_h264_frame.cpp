@@ -0,0 +1,166 @@
+/*
+ * H264访问单元(帧)组装实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <utility>
+#include "easy_h264_frame.h"
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 访问单元组装
+AccessUnitParse::AccessUnitParse(bool copy)
+{
+	this->copy = copy;
+	hasPicture = false;
+}
+
+/* 7.4.1.2.4：与上一个slice比较，判断是否为新的主图像的第一个VCL NALU */
+bool AccessUnitParse::IsNewPicture(const SliceHeader &sh)
+{
+	/* 缺少SPS/PPS无法解析frame_num等字段时，只能根据first_mb_in_slice判断 */
+	if (sh.parse_level < SLICE_PARSE_POC || last.parse_level < SLICE_PARSE_POC)
+		return sh.first_mb_in_slice == 0;
+
+	if (sh.frame_num != last.frame_num
+		|| sh.pic_parameter_set_id != last.pic_parameter_set_id
+		|| sh.field_pic_flag != last.field_pic_flag
+		|| sh.bottom_field_flag != last.bottom_field_flag)
+		return true;
+	if ((sh.nal_ref_idc == 0) != (last.nal_ref_idc == 0))
+		return true;
+	/* 不存在的字段为0，不需要再区分pic_order_cnt_type */
+	if (sh.pic_order_cnt_lsb != last.pic_order_cnt_lsb
+		|| sh.delta_pic_order_cnt_bottom != last.delta_pic_order_cnt_bottom
+		|| sh.delta_pic_order_cnt[0] != last.delta_pic_order_cnt[0]
+		|| sh.delta_pic_order_cnt[1] != last.delta_pic_order_cnt[1])
+		return true;
+	if (sh.IsIdr() != last.IsIdr())
+		return true;
+	if (sh.IsIdr() && sh.idr_pic_id != last.idr_pic_id)
+		return true;
+	return false;
+}
+
+void AccessUnitParse::Append(Nalu &nalu)
+{
+	if (copy)
+	{
+		/* data扩容时地址会变化，先记录偏移，输出时再设置NALU指针 */
+		offsets.push_back(current.data.size());
+		current.data.insert(current.data.end(), nalu.GetData(), nalu.GetData() + nalu.GetLength());
+	}
+	current.nalus.push_back(nalu);
+	current.size += nalu.GetLength();
+}
+
+/* 输出current，交换而不是拷贝，au原有的缓冲区留给下一个访问单元使用 */
+bool AccessUnitParse::Output(AccessUnit &au)
+{
+	if (current.nalus.empty())
+		return false;
+
+	if (copy)
+	{
+		for (size_t i = 0; i < current.nalus.size(); i++)
+			current.nalus[i].pdata = current.data.data() + offsets[i];
+	}
+	std::swap(au, current);
+	current.Clear();
+	offsets.clear();
+	hasPicture = false;
+	last.Reset();
+	return true;
+}
+
+bool AccessUnitParse::Push(Nalu &nalu, AccessUnit &au)
+{
+	if (!nalu.GetData() || nalu.GetLength() <= 0)
+		return false;
+
+	bool output = false;
+	int type = nalu.GetNaluType();
+	if (type == NALU_TYPE_SPS || type == NALU_TYPE_PPS)
+		cache.Update(nalu);
+
+	if (type == NALU_TYPE_SLICE || type == NALU_TYPE_DPA || type == NALU_TYPE_IDR)
+	{
+		/* 只需要解析到POC相关字段，解析失败时parse_level记录了已得到的字段 */
+		SliceHeader sh;
+		ParseSliceHeader(nalu.GetData(), nalu.GetLength(), cache, sh, SLICE_PARSE_POC);
+		if (sh.parse_level >= SLICE_PARSE_TYPE && sh.redundant_pic_cnt == 0) // 冗余图像属于当前访问单元
+		{
+			if (hasPicture && IsNewPicture(sh))
+				output = Output(au);
+			if (!hasPicture)
+			{
+				current.slice = sh;
+				hasPicture = true;
+			}
+			last = sh;
+		}
+		if (type == NALU_TYPE_IDR)
+			current.keyframe = true;
+	}
+	else if (hasPicture && (type == NALU_TYPE_AUD || type == NALU_TYPE_SPS
+		|| type == NALU_TYPE_PPS || type == NALU_TYPE_SEI || (type >= 14 && type <= 18)))
+	{
+		/* 主图像之后的这些NALU属于下一个访问单元 */
+		output = Output(au);
+	}
+
+	Append(nalu);
+	return output;
+}
+
+bool AccessUnitParse::Flush(AccessUnit &au)
+{
+	return Output(au);
+}
+
+void AccessUnitParse::Discard()
+{
+	current.Clear();
+	offsets.clear();
+	hasPicture = false;
+	last.Reset();
+}
+
+void AccessUnitParse::Reset()
+{
+	Discard();
+	cache.Clear();
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// H264文件按访问单元读取
+H264FrameParse::H264FrameParse(const std::string &filename, int readMode)
+	: file(filename, readMode), parser(!file.IsMapped())
+{
+	finished = false;
+}
+
+bool H264FrameParse::GetNextAccessUnit(AccessUnit &au)
+{
+	if (finished)
+		return false;
+
+	Nalu nalu;
+	while (file.GetNextNalu(nalu))
+	{
+		if (parser.Push(nalu, au))
+			return true;
+	}
+	finished = true;
+	return parser.Flush(au);
+}
+
+bool H264FrameParse::Seek(unsigned long long offset)
+{
+	if (!file.Seek(offset))
+		return false;
+	parser.Discard();
+	finished = false;
+	return true;
+}
+
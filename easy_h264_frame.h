@@ -0,0 +1,129 @@
+/*
+ * H264访问单元(帧)组装
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_FRAME_H__
+#define __FREE_EASY_H264_FRAME_H__
+#include "easy_h264_slice.h"
+
+// 访问单元：一帧图像及其前面的AUD/SPS/PPS/SEI等NALU
+typedef struct AccessUnit
+{
+	AccessUnit()
+	{
+		Clear();
+	}
+
+	void Clear()
+	{
+		nalus.clear();
+		data.clear();
+		keyframe = false;
+		size = 0;
+		slice.Reset();
+	}
+
+	int GetNaluCount()
+	{
+		return nalus.size();
+	}
+
+	/* 是否包含主图像的slice */
+	bool HasPicture()
+	{
+		return slice.parse_level >= SLICE_PARSE_TYPE;
+	}
+
+	std::vector<Nalu> nalus; // NALU视图，零拷贝时指向输入数据，拷贝模式下指向data
+	bool keyframe; // 是否包含IDR slice
+	int size; // 所有NALU长度之和(不含起始码)
+	SliceHeader slice; // 主图像第一个slice的头，解析到SLICE_PARSE_POC；缺少SPS/PPS时只有SLICE_PARSE_TYPE
+	std::vector<unsigned char> data; // 拷贝模式下保存NALU数据
+}AccessUnit;
+
+/*
+ * 访问单元组装(推模式)：按照H.264 7.4.1.2.3/7.4.1.2.4的规则检测新访问单元的开始
+ * 主图像的最后一个VCL NALU之后出现AUD/SPS/PPS/SEI/类型14~18的NALU，
+ * 或者slice头中frame_num、pic_parameter_set_id、POC等字段与上一个slice不同时，开始新的访问单元
+ */
+class AccessUnitParse
+{
+public:
+	/*
+	 * copy为false时，au中的NALU直接引用输入的nalu，调用者必须保证输入数据在au使用完毕前有效
+	 * copy为true时，输入的nalu拷贝到访问单元内部，Push返回后输入数据即可释放(用于H264StreamParse回调等场景)
+	 */
+	explicit AccessUnitParse(bool copy = false);
+	~AccessUnitParse()
+	{}
+
+	AccessUnitParse(const AccessUnitParse &b) = delete;
+	AccessUnitParse &operator=(const AccessUnitParse &b) = delete;
+
+	/* 输入一个NALU，如果它开始了新的访问单元，把之前的访问单元输出到au并返回true */
+	bool Push(Nalu &nalu, AccessUnit &au);
+
+	/* 输入结束，输出最后一个访问单元，没有时返回false */
+	bool Flush(AccessUnit &au);
+
+	/* 丢弃未输出的数据，保留已缓存的SPS/PPS，用于跳转到新的位置后继续组装 */
+	void Discard();
+
+	/* 丢弃未输出的数据以及缓存的SPS/PPS */
+	void Reset();
+
+	/* 组装过程中收到的SPS/PPS */
+	ParamSetCache &GetParamSetCache()
+	{
+		return cache;
+	}
+
+private:
+	bool IsNewPicture(const SliceHeader &sh);
+	void Append(Nalu &nalu);
+	bool Output(AccessUnit &au);
+
+	bool copy;
+	ParamSetCache cache; // 解析slice头需要的SPS/PPS
+	AccessUnit current; // 正在组装的访问单元
+	std::vector<int> offsets; // 拷贝模式：每个NALU在current.data中的偏移
+	bool hasPicture; // current已包含主图像的VCL NALU
+	SliceHeader last; // current中上一个主图像slice的头
+};
+
+// H264文件按访问单元读取：mmap方式下零拷贝，分块读取方式下拷贝到访问单元内部
+class H264FrameParse
+{
+public:
+	H264FrameParse() = delete;
+	H264FrameParse(const std::string &filename, int readMode = H264_FILE_READ_MMAP);
+	~H264FrameParse()
+	{}
+
+	/*
+	 * 获取一个访问单元，结束时返回false
+	 * au中的NALU在mmap方式下在对象析构前一直有效，分块读取方式下在au被再次使用前有效
+	 */
+	bool GetNextAccessUnit(AccessUnit &au);
+
+	/* 跳转到文件中的offset处(通常是某个访问单元的起始码位置)，已缓存的SPS/PPS保留 */
+	bool Seek(unsigned long long offset);
+
+	ParamSetCache &GetParamSetCache()
+	{
+		return parser.GetParamSetCache();
+	}
+
+	H264FrameParse(const H264FrameParse &b) = delete;
+	H264FrameParse &operator=(const H264FrameParse &b) = delete;
+
+private:
+	H264FileParse file;
+	AccessUnitParse parser;
+	bool finished;
+};
+
+#endif
+
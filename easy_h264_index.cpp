@@ -0,0 +1,283 @@
+/*
+ * H264索引文件实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "easy_h264_index.h"
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 索引建立
+/* FNV-1a哈希 */
+static unsigned long long HashHead(const unsigned char *data, size_t len)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/* 以只读方式映射整个文件，只支持普通文件 */
+static unsigned char *MapReadOnly(const std::string &filename, size_t &size)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	void *addr = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0
+		&& (unsigned long long)st.st_size <= (size_t)-1)
+	{
+		addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		size = st.st_size;
+	}
+	close(fd); // 映射建立后可以关闭文件
+	return addr == MAP_FAILED ? NULL : (unsigned char *)addr;
+}
+
+/* 把一个访问单元加入NALU表，关键帧同时加入GOP表，resume记录该访问单元的起始码位置 */
+static void AddFrame(const unsigned char *base, AccessUnit &au, unsigned int frame,
+	std::vector<H264IndexNalu> &nalus, std::vector<H264IndexGop> &gops, unsigned long long &resume)
+{
+	for (int i = 0; i < au.GetNaluCount(); i++)
+	{
+		Nalu &nalu = au.nalus[i];
+		H264IndexNalu entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.offset = nalu.GetData() - base;
+		entry.size = nalu.GetLength();
+		entry.frame = frame;
+		entry.type = nalu.GetNaluType();
+		entry.startCodeLen = (entry.offset >= 4 && base[entry.offset - 4] == 0) ? 4 : 3; // 与FindStartCode的判断一致
+		entry.keyframe = au.keyframe;
+
+		if (i == 0)
+		{
+			resume = entry.offset - entry.startCodeLen;
+			if (au.keyframe)
+			{
+				H264IndexGop gop;
+				gop.offset = resume;
+				gop.frame = frame;
+				gop.nalu = nalus.size();
+				gops.push_back(gop);
+			}
+		}
+		nalus.push_back(entry);
+	}
+}
+
+/* 写入临时文件后改名 */
+static bool WriteIndex(const std::string &indexFile, const H264IndexHeader &header,
+	const std::vector<H264IndexNalu> &nalus, const std::vector<H264IndexGop> &gops)
+{
+	std::string tmpFile = indexFile + ".tmp";
+	FILE *fp = fopen(tmpFile.c_str(), "wb");
+	if (!fp)
+		return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (ok && !nalus.empty())
+		ok = fwrite(nalus.data(), sizeof(H264IndexNalu), nalus.size(), fp) == nalus.size();
+	if (ok && !gops.empty())
+		ok = fwrite(gops.data(), sizeof(H264IndexGop), gops.size(), fp) == gops.size();
+	if (fclose(fp) != 0)
+		ok = false;
+
+	if (ok && rename(tmpFile.c_str(), indexFile.c_str()) == 0)
+		return true;
+	unlink(tmpFile.c_str());
+	return false;
+}
+
+bool BuildH264Index(const std::string &h264File, const std::string &indexFile)
+{
+	size_t size = 0;
+	unsigned char *base = MapReadOnly(h264File, size);
+	if (!base)
+		return false;
+	madvise(base, size, MADV_SEQUENTIAL);
+
+	std::vector<H264IndexNalu> nalus;
+	std::vector<H264IndexGop> gops;
+	AccessUnitParse parser; // 零拷贝，NALU指向文件映射
+	unsigned long long resume = 0;
+	unsigned int frame = 0;
+
+	/* 已有索引属于该文件时，保留最后一帧之前的部分，并用其中的SPS/PPS初始化参数集缓存 */
+	H264Index old;
+	if (old.Load(indexFile))
+	{
+		const H264IndexHeader *h = old.GetHeader();
+		size_t hashSize = h->fileSize < H264_INDEX_HASH_SIZE ? h->fileSize : H264_INDEX_HASH_SIZE;
+		if (h->frameCount > 0 && h->fileSize <= size && h->resumeOffset < size
+			&& HashHead(base, hashSize) == h->headHash)
+		{
+			unsigned int last = h->frameCount - 1;
+			for (unsigned int i = 0; i < h->naluCount; i++)
+			{
+				const H264IndexNalu *entry = old.GetNalu(i);
+				if (entry->frame >= last)
+					break;
+				nalus.push_back(*entry);
+				if (entry->type == NALU_TYPE_SPS || entry->type == NALU_TYPE_PPS)
+				{
+					Nalu nalu;
+					nalu.SetData(base + entry->offset, entry->size);
+					parser.GetParamSetCache().Update(nalu);
+				}
+			}
+			for (unsigned int i = 0; i < h->gopCount && old.GetGop(i)->frame < last; i++)
+				gops.push_back(*old.GetGop(i));
+			resume = h->resumeOffset;
+			frame = last;
+		}
+	}
+	old.Close();
+
+	/* 与H264FileParse一致：忽略最后4个字节内的起始码 */
+	const unsigned char *end = base + size;
+	int startCodeLen = 0;
+	const unsigned char *p = FindStartCode(base + resume, end, &startCodeLen);
+	if (p && (size_t)(p - base) + 4 >= size)
+		p = NULL;
+
+	AccessUnit au;
+	while (p)
+	{
+		const unsigned char *data = p + startCodeLen;
+		const unsigned char *next = FindStartCode(data, end, &startCodeLen);
+		if (next && (size_t)(next - base) + 4 >= size)
+			next = NULL;
+
+		Nalu nalu;
+		nalu.SetData((unsigned char *)data, (int)((next ? next : end) - data));
+		if (parser.Push(nalu, au))
+			AddFrame(base, au, frame++, nalus, gops, resume);
+		p = next;
+	}
+	if (parser.Flush(au))
+		AddFrame(base, au, frame++, nalus, gops, resume);
+
+	H264IndexHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, H264_INDEX_MAGIC, sizeof(header.magic));
+	header.version = H264_INDEX_VERSION;
+	header.headerSize = sizeof(header);
+	header.fileSize = size;
+	header.headHash = HashHead(base, size < H264_INDEX_HASH_SIZE ? size : H264_INDEX_HASH_SIZE);
+	header.resumeOffset = resume;
+	header.naluCount = nalus.size();
+	header.frameCount = frame;
+	header.gopCount = gops.size();
+	munmap(base, size);
+
+	return WriteIndex(indexFile, header, nalus, gops);
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 索引读取
+H264Index::H264Index()
+{
+	mapData = NULL;
+	mapSize = 0;
+	header = NULL;
+	nalus = NULL;
+	gops = NULL;
+}
+
+H264Index::~H264Index()
+{
+	Close();
+}
+
+bool H264Index::Load(const std::string &indexFile)
+{
+	Close();
+	mapData = MapReadOnly(indexFile, mapSize);
+	if (!mapData)
+		return false;
+
+	/* 检查格式及各个表的长度 */
+	const H264IndexHeader *h = (const H264IndexHeader *)mapData;
+	if (mapSize < sizeof(H264IndexHeader)
+		|| memcmp(h->magic, H264_INDEX_MAGIC, sizeof(h->magic)) != 0
+		|| h->version != H264_INDEX_VERSION || h->headerSize != sizeof(H264IndexHeader)
+		|| mapSize < sizeof(H264IndexHeader) + (unsigned long long)h->naluCount * sizeof(H264IndexNalu)
+			+ (unsigned long long)h->gopCount * sizeof(H264IndexGop))
+	{
+		Close();
+		return false;
+	}
+
+	header = h;
+	nalus = (const H264IndexNalu *)(mapData + sizeof(H264IndexHeader));
+	gops = (const H264IndexGop *)(nalus + h->naluCount);
+	return true;
+}
+
+void H264Index::Close()
+{
+	if (mapData) munmap(mapData, mapSize); mapData = NULL;
+	mapSize = 0;
+	header = NULL;
+	nalus = NULL;
+	gops = NULL;
+}
+
+/* NALU表按frame递增，二分查找第一个frame不小于目标的表项 */
+int H264Index::FindFrame(unsigned int frame)
+{
+	unsigned int lo = 0, hi = GetNaluCount();
+	while (lo < hi)
+	{
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (nalus[mid].frame < frame)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo < GetNaluCount() && nalus[lo].frame == frame) ? (int)lo : -1;
+}
+
+/* GOP表按frame递增，二分查找最后一个frame不大于目标的表项 */
+int H264Index::FindGop(unsigned int frame)
+{
+	if (frame >= GetFrameCount())
+		return -1;
+	unsigned int lo = 0, hi = GetGopCount();
+	while (lo < hi)
+	{
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (gops[mid].frame <= frame)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (int)lo - 1;
+}
+
+long long H264Index::GetFrameOffset(unsigned int frame)
+{
+	int n = FindFrame(frame);
+	if (n < 0)
+		return -1;
+	return nalus[n].offset - nalus[n].startCodeLen;
+}
+
+long long H264Index::GetIdrOffset(unsigned int n)
+{
+	if (n >= GetGopCount())
+		return -1;
+	return gops[n].offset;
+}
+
@@ -0,0 +1,123 @@
+/*
+ * H264索引文件：NALU表及GOP表，用于快速跳转
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_INDEX_H__
+#define __FREE_EASY_H264_INDEX_H__
+#include "easy_h264_frame.h"
+
+#define H264_INDEX_MAGIC "EH264IDX"
+#define H264_INDEX_VERSION 1
+#define H264_INDEX_HASH_SIZE 4096 // 用文件开头的这些字节判断索引是否属于该文件
+
+/*
+ * 索引文件格式(本机字节序)：H264IndexHeader，之后是naluCount个H264IndexNalu，再之后是gopCount个H264IndexGop
+ * 文件可能还在增长，最后一帧不一定完整，增量更新时从最后一帧重新开始索引
+ */
+typedef struct H264IndexHeader
+{
+	char magic[8];                      // H264_INDEX_MAGIC
+	unsigned int version;               // H264_INDEX_VERSION
+	unsigned int headerSize;            // sizeof(H264IndexHeader)
+	unsigned long long fileSize;        // 建立索引时h264文件的大小
+	unsigned long long headHash;        // h264文件开头min(fileSize, H264_INDEX_HASH_SIZE)字节的哈希
+	unsigned long long resumeOffset;    // 最后一帧的起始码位置，增量更新从这里开始
+	unsigned int naluCount;
+	unsigned int frameCount;            // 访问单元个数
+	unsigned int gopCount;
+	unsigned int reserved;
+}H264IndexHeader;
+
+// NALU表项，按文件中的顺序排列
+typedef struct H264IndexNalu
+{
+	unsigned long long offset;          // NALU数据(起始码之后)在文件中的位置
+	unsigned int size;                  // NALU长度，不含起始码
+	unsigned int frame;                 // 所属访问单元的序号，单调递增
+	unsigned char type;                 // nal_unit_type
+	unsigned char startCodeLen;         // 3或4
+	unsigned char keyframe;             // 所属访问单元是否为关键帧
+	unsigned char reserved[5];
+}H264IndexNalu;
+
+// GOP表项：每个关键帧(IDR)访问单元开始一个GOP
+typedef struct H264IndexGop
+{
+	unsigned long long offset;          // 关键帧访问单元第一个NALU的起始码位置
+	unsigned int frame;                 // 关键帧访问单元的序号
+	unsigned int nalu;                  // 关键帧访问单元第一个NALU在NALU表中的序号
+}H264IndexGop;
+
+/*
+ * 为h264File建立索引并写入indexFile(先写临时文件再改名，不影响正在使用旧索引的读者)
+ * indexFile已存在且属于该文件时，只从上次索引的最后一帧开始扫描，用于不断增长的录像文件
+ * h264File必须是可以mmap的普通文件，成功返回true
+ */
+bool BuildH264Index(const std::string &h264File, const std::string &indexFile);
+
+// 索引文件读取：mmap方式加载，查找为O(log n)
+class H264Index
+{
+public:
+	H264Index();
+	~H264Index();
+
+	/* 加载索引文件，格式不对时返回false */
+	bool Load(const std::string &indexFile);
+	void Close();
+
+	const H264IndexHeader *GetHeader()
+	{
+		return header;
+	}
+
+	unsigned int GetNaluCount()
+	{
+		return header ? header->naluCount : 0;
+	}
+	unsigned int GetFrameCount()
+	{
+		return header ? header->frameCount : 0;
+	}
+	unsigned int GetGopCount()
+	{
+		return header ? header->gopCount : 0;
+	}
+
+	const H264IndexNalu *GetNalu(unsigned int n)
+	{
+		return n < GetNaluCount() ? &nalus[n] : NULL;
+	}
+	const H264IndexGop *GetGop(unsigned int n)
+	{
+		return n < GetGopCount() ? &gops[n] : NULL;
+	}
+
+	/* 第frame帧的第一个NALU在NALU表中的序号，不存在时返回-1 */
+	int FindFrame(unsigned int frame);
+
+	/* 包含第frame帧的GOP序号(即该帧之前最近的关键帧)，不存在时返回-1 */
+	int FindGop(unsigned int frame);
+
+	/*
+	 * 第frame帧、第n个IDR帧的起始码在h264文件中的位置，不存在时返回-1
+	 * 可以直接传给H264FileParse::Seek/H264FrameParse::Seek
+	 */
+	long long GetFrameOffset(unsigned int frame);
+	long long GetIdrOffset(unsigned int n);
+
+	H264Index(const H264Index &b) = delete;
+	H264Index &operator=(const H264Index &b) = delete;
+
+private:
+	unsigned char *mapData;
+	size_t mapSize;
+	const H264IndexHeader *header;
+	const H264IndexNalu *nalus;
+	const H264IndexGop *gops;
+};
+
+#endif
+
@@ -0,0 +1,203 @@
+/*
+ * H264并行解析实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "easy_h264_parallel.h"
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 线程池
+ThreadPool::ThreadPool(int threads)
+{
+	pending = 0;
+	stop = false;
+	if (threads <= 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(std::thread(&ThreadPool::Run, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	taskCond.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void ThreadPool::Submit(const std::function<void()> &task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(task);
+		pending++;
+	}
+	taskCond.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCond.wait(lock, [this]() { return pending == 0; });
+}
+
+void ThreadPool::Run()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taskCond.wait(lock, [this]() { return stop || !tasks.empty(); });
+			if (tasks.empty()) // stop为true且没有剩余任务
+				return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--pending == 0)
+			doneCond.notify_all();
+	}
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 分段并行查找
+/* 查找[begin, end)中起始的所有 00 00 01，可以读到end之后2个字节(不超过len) */
+static void ScanRange(const unsigned char *data, size_t len, size_t begin, size_t end, std::vector<size_t> &out)
+{
+	out.clear();
+	const unsigned char *limit = data + (end + 2 < len ? end + 2 : len);
+	int startCodeLen = 0;
+	const unsigned char *p = FindStartCode(data + begin, limit, &startCodeLen);
+	while (p)
+	{
+		size_t pos = p - data + startCodeLen - 3; // 00 00 01 的位置，4字节起始码在拼接时重新判断
+		if (pos >= end)
+			break;
+		out.push_back(pos);
+		p = FindStartCode(data + pos + 3, limit, &startCodeLen);
+	}
+}
+
+H264ParallelScan::H264ParallelScan(int threads)
+	: pool(threads)
+{
+	mapData = NULL;
+	mapSize = 0;
+}
+
+H264ParallelScan::~H264ParallelScan()
+{
+	Unmap();
+}
+
+void H264ParallelScan::Unmap()
+{
+	if (mapData) munmap(mapData, mapSize); mapData = NULL;
+	mapSize = 0;
+}
+
+std::vector<Nalu> &H264ParallelScan::Scan(const unsigned char *data, size_t len)
+{
+	Nalus.clear();
+	if (!data || len <= 4)
+		return Nalus;
+
+	/* 分段数为线程数的4倍，使各线程的负载更均匀 */
+	size_t count = len / PARALLEL_MIN_RANGE_SIZE;
+	size_t maxCount = pool.GetThreadCount() * 4;
+	if (count > maxCount)
+		count = maxCount;
+	if (count < 1)
+		count = 1;
+	if (patterns.size() < count)
+		patterns.resize(count);
+
+	size_t rangeSize = (len + count - 1) / count;
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t begin = i * rangeSize;
+		size_t end = (begin + rangeSize < len) ? begin + rangeSize : len;
+		std::vector<size_t> *out = &patterns[i];
+		if (count == 1)
+			ScanRange(data, len, begin, end, *out); // 只有一段时不经过线程池
+		else
+			pool.Submit([data, len, begin, end, out]() { ScanRange(data, len, begin, end, *out); });
+	}
+	if (count > 1)
+		pool.Wait();
+
+	/*
+	 * 按顺序拼接：00 00 01 前一个字节为0时是4字节起始码(与串行查找一致，两个起始码不会重叠)
+	 * 与串行查找一致，起始码开始于最后4个字节内时忽略
+	 */
+	unsigned char *base = const_cast<unsigned char *>(data);
+	size_t prev = 0; // 上一个NALU数据的起始位置
+	bool hasPrev = false;
+	for (size_t i = 0; i < count; i++)
+	{
+		std::vector<size_t> &pos = patterns[i];
+		for (size_t k = 0; k < pos.size(); k++)
+		{
+			size_t start = (pos[k] > 0 && data[pos[k] - 1] == 0) ? pos[k] - 1 : pos[k];
+			if (start + 4 >= len)
+				break;
+			if (hasPrev)
+			{
+				Nalu nalu;
+				nalu.SetData(base + prev, (int)(start - prev));
+				Nalus.push_back(nalu);
+			}
+			prev = pos[k] + 3;
+			hasPrev = true;
+		}
+	}
+	if (hasPrev)
+	{
+		Nalu nalu;
+		nalu.SetData(base + prev, (int)(len - prev));
+		Nalus.push_back(nalu);
+	}
+	return Nalus;
+}
+
+std::vector<Nalu> &H264ParallelScan::ScanFile(const std::string &filename)
+{
+	Nalus.clear();
+	Unmap();
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return Nalus;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0
+		&& (unsigned long long)st.st_size <= (size_t)-1)
+	{
+		/* 与H264FileParse一致，MAP_PRIVATE写时拷贝：调用者修改nalu数据不会影响文件 */
+		void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED)
+		{
+			mapData = (unsigned char *)addr;
+			mapSize = st.st_size;
+		}
+	}
+	close(fd);
+
+	if (!mapData)
+		return Nalus;
+	return Scan(mapData, mapSize);
+}
+
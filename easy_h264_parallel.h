@@ -0,0 +1,88 @@
+/*
+ * H264并行解析：线程池及大文件分段并行查找起始码
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_PARALLEL_H__
+#define __FREE_EASY_H264_PARALLEL_H__
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "easy_h264_parser.h"
+
+#define PARALLEL_MIN_RANGE_SIZE (1024*1024) // 每段至少1MB，太小时线程调度开销大于查找本身
+
+// 固定大小的线程池
+class ThreadPool
+{
+public:
+	/* threads为0时使用CPU核数 */
+	explicit ThreadPool(int threads = 0);
+	~ThreadPool();
+
+	/* 提交任务，由空闲线程按提交顺序取出执行 */
+	void Submit(const std::function<void()> &task);
+
+	/* 等待已提交的任务全部执行完毕 */
+	void Wait();
+
+	int GetThreadCount()
+	{
+		return workers.size();
+	}
+
+	ThreadPool(const ThreadPool &b) = delete;
+	ThreadPool &operator=(const ThreadPool &b) = delete;
+
+private:
+	void Run();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()> > tasks;
+	std::mutex mutex;
+	std::condition_variable taskCond; // 有新任务或需要退出
+	std::condition_variable doneCond; // 任务全部完成
+	int pending; // 已提交但还没有执行完的任务数
+	bool stop;
+};
+
+/*
+ * 分段并行查找起始码：把数据分成多段，每段由线程池中的一个线程查找，最后按顺序拼接
+ * 起始码可能跨越两段的边界，每段多读2个字节，只保留起始位置在本段内的起始码
+ * 得到的NALU列表与H264FileParse/NaluParse串行查找的结果完全相同(包括忽略最后4个字节内的起始码)
+ */
+class H264ParallelScan
+{
+public:
+	/* threads为0时使用CPU核数 */
+	explicit H264ParallelScan(int threads = 0);
+	~H264ParallelScan();
+
+	/* 查找data中的所有NALU，返回的Nalu直接指向data(零拷贝)，在下一次查找前有效 */
+	std::vector<Nalu> &Scan(const unsigned char *data, size_t len);
+
+	/* mmap整个文件后查找，返回的Nalu指向文件映射，在下一次查找或对象析构前有效，失败时返回空列表 */
+	std::vector<Nalu> &ScanFile(const std::string &filename);
+
+	int GetThreadCount()
+	{
+		return pool.GetThreadCount();
+	}
+
+	H264ParallelScan(const H264ParallelScan &b) = delete;
+	H264ParallelScan &operator=(const H264ParallelScan &b) = delete;
+
+private:
+	void Unmap();
+
+	ThreadPool pool;
+	std::vector<std::vector<size_t> > patterns; // 每段中 00 00 01 的位置，重复使用避免每次分配
+	std::vector<Nalu> Nalus;
+	unsigned char *mapData; // ScanFile的文件映射
+	size_t mapSize;
+};
+
+#endif
+
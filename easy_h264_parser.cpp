@@ -6,114 +6,240 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "easy_h264_parser.h"
+#include "easy_h264_aio.h"
+#include "easy_h264_stats.h"
 
  //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
  // 位操作：用于解析SPS帧信息
- /* 读取1bit */
+ /* 补充缓存，使有效位数至少为57(数据足够时) */
+void BitStream::Refill()
+{
+	int bytes = (64 - cache_bits) >> 3; // 还能装入的字节数
+	if (bytes <= 0)
+		return;
+
+	if (ebsp)
+	{
+		RefillEbsp();
+		return;
+	}
+
+	if (end - p >= 8) // 整字读取
+	{
+		unsigned long long v;
+		memcpy(&v, p, 8);
+		v = __builtin_bswap64(v);
+		if (bytes < 8)
+			v &= ~0ULL << (64 - bytes * 8);
+		cache |= v >> cache_bits;
+		cache_bits += bytes * 8;
+		p += bytes;
+		return;
+	}
+
+	/* 接近末尾时逐字节装入 */
+	while (bytes-- > 0 && p < end)
+	{
+		cache |= (unsigned long long)(*p++) << (56 - cache_bits);
+		cache_bits += 8;
+	}
+}
+
+/* EBSP模式补充缓存：要装入的字节中没有0x03时仍按整字读取，否则逐字节判断防竞争字节 */
+void BitStream::RefillEbsp()
+{
+	int bytes = (64 - cache_bits) >> 3;
+	if (end - p >= 8)
+	{
+		unsigned long long v;
+		memcpy(&v, p, 8);
+		v = __builtin_bswap64(v);
+		unsigned long long mask = bytes < 8 ? ~0ULL << (64 - bytes * 8) : ~0ULL;
+		unsigned long long x = v ^ 0x0303030303030303ULL;
+		if ((((x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL) & mask) == 0)
+		{
+			cache |= (v & mask) >> cache_bits;
+			cache_bits += bytes * 8;
+			p += bytes;
+
+			/* 更新末尾连续0的个数 */
+			if (p[-1] != 0)
+				zeros = 0;
+			else if (bytes >= 2)
+				zeros = p[-2] == 0 ? 2 : 1;
+			else if (zeros < 2)
+				zeros++;
+			return;
+		}
+	}
+
+	while (bytes > 0 && p < end)
+	{
+		unsigned char b = *p++;
+		/* 与EbspToRbsp规则一致：00 00 03之后为00~03或已是最后一个字节 */
+		if (zeros >= 2 && b == 0x03 && (p >= end || *p <= 0x03))
+		{
+			zeros = 0;
+			epb_count++;
+			continue;
+		}
+		zeros = b ? 0 : (zeros < 2 ? zeros + 1 : 2);
+		cache |= (unsigned long long)b << (56 - cache_bits);
+		cache_bits += 8;
+		bytes--;
+	}
+}
+
+/* 读取1bit */
 int BitStream::ReadU1()
 {
-	int r = 0;
-	bits_left--;
-	r = ((*(p)) >> bits_left) & 0x01;
-	if (bits_left == 0)
+	if (cache_bits < 1)
 	{
-		p++;
-		bits_left = 8;
+		Refill();
+		if (cache_bits < 1)
+		{
+			error = true;
+			return 0;
+		}
 	}
+	int r = (int)(cache >> 63);
+	cache <<= 1;
+	cache_bits--;
 	return r;
 }
 
 /* 读取n个bit */
 int BitStream::ReadU(int n)
 {
-	int r = 0, i;
-	for (i = 0; i < n; i++)
+	if (n <= 0)
+		return 0;
+	if (n > 32)
+		n = 32;
+
+	if (cache_bits < n)
 	{
-		int rval = ReadU1();
-		int rshift = (n - i - 1);
-		r |= (rval << rshift);
+		Refill();
+		if (cache_bits < n) // 数据不足：返回剩余的位，不足部分补0
+		{
+			unsigned int r = (unsigned int)(cache >> (64 - n));
+			cache = 0;
+			cache_bits = 0;
+			error = true;
+			return (int)r;
+		}
 	}
-	return r;
+	unsigned int r = (unsigned int)(cache >> (64 - n));
+	cache <<= n;
+	cache_bits -= n;
+	return (int)r;
 }
 
-/* 解码：无符号指数哥伦布熵编码 */
-int BitStream::ReadUE()
+/* 跳过n个bit */
+void BitStream::SkipU(int n)
 {
-	int r = 0, i = 0;
-	while ((ReadU1() == 0) && (i < size * 8/*32*/))
+	if (n <= 0)
+		return;
+	if (n <= cache_bits)
 	{
-		i++;
+		cache = n < 64 ? cache << n : 0;
+		cache_bits -= n;
+		return;
 	}
-	/* 上面已经把 00101 中的第一个1读取了，当前指向的是倒数第二个0 */
-	r = ReadU(i); // 有效bit数是0的个数+1，本来是i+1，但1已经读了
-	r += (1 << i) - 1;
-	return r;
+
+	/* EBSP模式下需要逐段读取以跳过防竞争字节 */
+	if (ebsp)
+	{
+		while (n > 32 && !error)
+		{
+			ReadU(32);
+			n -= 32;
+		}
+		ReadU(n);
+		return;
+	}
+
+	/* 丢弃缓存，直接移动字节指针 */
+	n -= cache_bits;
+	cache = 0;
+	cache_bits = 0;
+	if (n / 8 > end - p)
+	{
+		p = end;
+		error = true;
+		return;
+	}
+	p += n / 8;
+	ReadU(n % 8);
 }
 
-/* 解码：无符号指数哥伦布熵编码，与ReadUE()功能一样 */
-int BitStream::ReadUE1()
+/* more_rbsp_data()：剩余数据中除rbsp_stop_one_bit外还有为1的位 */
+bool BitStream::MoreRbspData()
 {
-	int r = 0, i = 0, zero = 0, shift = 0;
-	while (i < size * 8)
+	BitStream bs = *this; // 向前查看，不影响当前位置
+	int ones = 0;
+	while (ones < 2)
 	{
-		i++;
-		r = ReadU1();
-		if (r)
-		{
-			shift = zero;
-			r = r << shift;
+		int n = bs.GetBitsLeft() < 32 ? bs.GetBitsLeft() : 32;
+		if (n <= 0)
+			break;
+		ones += __builtin_popcount((unsigned int)bs.ReadU(n));
+		if (bs.IsError())
 			break;
-		}
-		else
-			zero++;
 	}
-	for (int n = 0; n < zero; n++) // 读取剩余位
+	return ones >= 2;
+}
+
+/* 解码：无符号指数哥伦布熵编码 */
+int BitStream::ReadUE()
+{
+	if (cache_bits < 32)
+		Refill();
+
+	int zeros = cache ? __builtin_clzll(cache) : 64;
+	if (zeros >= cache_bits || zeros > 31) // 数据不足，或超出32位范围
 	{
-		int tmp = ReadU1();
-		tmp = tmp << (shift - n - 1);
-		r += tmp;
+		cache = 0;
+		cache_bits = 0;
+		error = true;
+		return 0;
 	}
-	r -= 1; // 减去1得到真实值
-	return r;
+
+	/* 码字长度为2*zeros+1，在缓存内时一次取出 */
+	int n = 2 * zeros + 1;
+	if (n <= cache_bits)
+	{
+		unsigned long long v = cache >> (64 - n);
+		cache = n < 64 ? cache << n : 0;
+		cache_bits -= n;
+		return (int)(v - 1);
+	}
+
+	SkipU(zeros + 1);
+	return (int)((1u << zeros) - 1 + (unsigned int)ReadU(zeros));
+}
+
+/* 解码：无符号指数哥伦布熵编码，与ReadUE()功能一样 */
+int BitStream::ReadUE1()
+{
+	return ReadUE();
 }
 
 /* 解码：有符号指数哥伦布熵编码 */
 int BitStream::ReadSE()
 {
-	int r = ReadUE();
-	if (r & 0x1)
-		r = (r + 1) / 2;
-	else
-		r = -(r / 2);
-	return r;
+	unsigned int k = (unsigned int)ReadUE();
+	if (k & 0x1)
+		return (int)((k + 1) / 2);
+	return -(int)(k / 2);
 }
 
 /* 解码：有符号指数哥伦布熵编码，与ReadSE()功能一样 */
 int BitStream::ReadSE1()
 {
-	int r = 0, i = 0, zero = 0, shift = 0;
-	while (i < size * 8)
-	{
-		i++;
-		r = ReadU1();
-		if (r)
-		{
-			shift = (i - 2);
-			r = r << shift;
-			break;
-		}
-		else
-			zero++;
-	}
-	for (int n = 0; n < zero - 1; n++) // 读取剩余位
-	{
-		int tmp = ReadU1();
-		tmp = tmp << (shift - n - 1);
-		r += tmp;
-	}
-	int sign = ReadU1(); // 读取符号位：0正1负
-	return sign ? -r : r;
+	return ReadSE();
 }
 
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
@@ -124,65 +250,48 @@ std::vector<Nalu> &NaluParse::GetNalusFromFrame(const unsigned char *h264Frame,
 	Nalus.clear();
 	if (h264Frame && h264FrameLen > 3)
 	{
-		if (stream)
-			delete stream;
-
+		H264_STAT_TIMER(H264_STAGE_SCAN);
+		H264_STAT_ADD(H264_STAT_BYTES_SCANNED, h264FrameLen);
 		if (lastFrameIndex)
 			*lastFrameIndex = -1;
 
-		len = h264FrameLen;
-		stream = new unsigned char[len];
-		memcpy(this->stream, h264Frame, len);
+		/* 零拷贝模式直接引用调用者的缓冲区，否则拷贝到重复使用的缓冲区中 */
+		unsigned char *data = const_cast<unsigned char *>(h264Frame);
+		if (!zeroCopy)
+		{
+			data = stream.Reserve(h264FrameLen);
+			memcpy(data, h264Frame, h264FrameLen);
+			H264_STAT_ADD(H264_STAT_MOVE_BYTES, h264FrameLen);
+		}
 
-		int i = 0, startCode = -1;
-		std::vector<StartCodeInfo> startCodeIdx; // 保存每一帧的起始码下标索引
-		for (i = 0; i < h264FrameLen - 4;)
+		/* 找到下一帧的起始码时，上一帧就完整了，不需要先保存所有起始码的位置 */
+		int startCodeLen = 0;
+		const unsigned char *end = data + h264FrameLen;
+		const unsigned char *p = FindStartCode(data, end, &startCodeLen);
+		unsigned char *prev = NULL; // 上一帧数据(起始码之后)的位置
+		while (p && (p - data) < h264FrameLen - 4)
 		{
-			if (stream[i] == 0 && stream[i + 1] == 0
-				&& stream[i + 2] == 1)
+			if (prev)
 			{
-				startCode = i + 3;
-			}
-			else if (stream[i] == 0 && stream[i + 1] == 0
-				&& stream[i + 2] == 0 && stream[i + 3] == 1)
-			{
-				startCode = i + 4;
+				Nalu packet;
+				packet.SetData(prev, p - prev);
+				Nalus.push_back(packet);
+				H264_STAT_NALU(packet.type, 1);
 			}
 
-			/* 得到起始码 */
-			if (startCode > 0)
-			{
-				StartCodeInfo info;
-				info.startCodeIndex = i;
-				info.startCodeLen = (startCode - i);
-				startCodeIdx.push_back(info);
-
-				if (lastFrameIndex) // 记录最后一帧的起始码位置
-					*lastFrameIndex = i;
+			if (lastFrameIndex) // 记录最后一帧的起始码位置
+				*lastFrameIndex = p - data;
 
-				i = startCode;
-				startCode = -1; // 继续查找下一帧
-			}
-			else
-				i++;
+			prev = data + (p - data) + startCodeLen;
+			p = FindStartCode(prev, end, &startCodeLen); // 继续查找下一帧
 		}
 
-		if (startCodeIdx.size() > 0)
+		if (prev)
 		{
-			for (int n = 0; n < startCodeIdx.size(); n++)
-			{
-				int plen = h264FrameLen;
-				if (n == startCodeIdx.size() - 1)
-					plen = h264FrameLen;
-				else
-					plen = startCodeIdx[n + 1].startCodeIndex;
-
-				Nalu packet;
-				packet.SetData(
-					stream + startCodeIdx[n].startCodeIndex + startCodeIdx[n].startCodeLen,
-					plen - startCodeIdx[n].startCodeIndex - startCodeIdx[n].startCodeLen);
-				Nalus.push_back(packet);
-			}
+			Nalu packet;
+			packet.SetData(prev, end - prev);
+			Nalus.push_back(packet);
+			H264_STAT_NALU(packet.type, 1);
 		}
 	}
 	return Nalus;
@@ -190,199 +299,797 @@ std::vector<Nalu> &NaluParse::GetNalusFromFrame(const unsigned char *h264Frame,
 
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // H264文件解析
-H264FileParse::H264FileParse(const std::string &filename)
+H264FileParse::H264FileParse(const std::string &filename, int readMode, H264Allocator *allocator)
+	: parser(true), buffer(allocator) // stream由本对象管理，parser无需再拷贝
 {
 	fp = fopen(filename.c_str(), "rb");
 
 	realReadSize = 0;
 	lastFrameIndex = 0;
 
-	parser = NULL;
 	stream = NULL;
 
-	Nalus.clear();
+	Nalus = NULL;
+	naluIndex = 0;
+	naluCount = 0;
+	streamOffset = 0;
+	readOffset = 0;
+
+	mapData = NULL;
+	mapSize = 0;
+	mapPos = 0;
+	mapStartCodeLen = 0;
+
+	reader = NULL;
+	heldChunk = NULL;
+	readerEof = false;
 	
 	if (fp)
 	{
-		parser = new NaluParse();
-		stream = new unsigned char [READ_BUFF_SIZE];
+		if (readMode == H264_FILE_READ_MMAP && MapFile())
+			return;
+
+		struct stat st;
+		if (readMode == H264_FILE_READ_ASYNC && fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode)
+			&& st.st_size > ASYNC_READ_CHUNK_SIZE) // 不超过一块的小文件直接分块读取，省去创建io_uring及缓冲区的开销
+		{
+			/* 每块之前预留一块大小，上一块剩余的最后一帧拷贝到这里，不用整块拷贝 */
+			reader = new H264AsyncReader(fileno(fp), ASYNC_READ_CHUNK_SIZE, ASYNC_READ_DEPTH, ASYNC_READ_CHUNK_SIZE, allocator);
+			return;
+		}
+
+		stream = buffer.Reserve(READ_BUFF_SIZE);
 	}
 }
 
 H264FileParse::~H264FileParse()
 {
+	if (mapData) munmap(mapData, mapSize); mapData = NULL;
+	if (reader) delete reader; reader = NULL; // 先等待读取结束再关闭文件
 	if (fp) fclose(fp); fp = NULL;
-	if (parser) delete parser; parser = NULL;
-	if (stream) delete stream; stream = NULL;
+	stream = NULL; // 由buffer释放
 }
 
-// 获取一帧NALU
-bool H264FileParse::GetNextNalu(Nalu &nalu)
+/* 映射整个文件，只支持普通文件，失败时返回false */
+bool H264FileParse::MapFile()
 {
-	if (fp)
+	struct stat st;
+	int fd = fileno(fp);
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+		return false;
+	if ((unsigned long long)st.st_size > (size_t)-1)
+		return false; // 32位系统下文件过大
+
+	/* MAP_PRIVATE写时拷贝：调用者修改nalu数据不会影响文件 */
+	void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED)
+		return false;
+	madvise(addr, st.st_size, MADV_SEQUENTIAL); // 顺序读取，让内核加大预读
+
+	mapData = (unsigned char *)addr;
+	mapSize = st.st_size;
+
+	/* 找到第一帧的起始码，之前的数据丢弃 */
+	const unsigned char *p = FindStartCode(mapData, mapData + mapSize, &mapStartCodeLen);
+	mapPos = (p && (size_t)(p - mapData) + 4 < mapSize) ? (p - mapData) : mapSize;
+	return true;
+}
+
+/* mmap方式：从当前起始码开始查找下一个起始码，两者之间即为一帧，每个字节只扫描一次 */
+bool H264FileParse::GetNextMappedNalu(Nalu &nalu)
+{
+	H264_STAT_TIMER(H264_STAGE_SCAN);
+	while (mapPos < mapSize)
 	{
-		if (Nalus.size() > 0)
-		{
-			nalu = Nalus[0];
-			Nalus.erase(Nalus.begin());
-			return true;
-		}
+		size_t start = mapPos + mapStartCodeLen;
+		int startCodeLen = 0;
+		const unsigned char *p = FindStartCode(mapData + start, mapData + mapSize, &startCodeLen);
+		size_t next = mapSize;
+		if (p && (size_t)(p - mapData) + 4 < mapSize) // 与NaluParse一致：忽略最后4个字节内的起始码
+			next = p - mapData;
+		H264_STAT_ADD(H264_STAT_BYTES_SCANNED, next - mapPos);
+		mapPos = next;
+		mapStartCodeLen = startCodeLen;
 
-		/* 读取文件数据 */
-		int left = (realReadSize - lastFrameIndex) > 0 ? (realReadSize - lastFrameIndex) : 0;
-		memmove(stream, stream + lastFrameIndex, left); // 将上一次解析后剩余的数据移动到前面
+		/* 整个文件都已映射，NALU(或没有起始码的一段数据)可能超过int的范围：超过MAX_NALU_SIZE时丢弃 */
+		if (next - start > MAX_NALU_SIZE)
+			continue;
+
+		Nalu packet;
+		packet.SetData(mapData + start, (int)(next - start));
+		nalu = packet;
+		H264_STAT_NALU(packet.type, 1);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * 分块读取方式：读取下一块数据并解析，失败或没有数据时返回false
+ * 最后一帧可能不完整，留到下次与后面的数据一起解析；一块中还没有完整的一帧(单帧大于缓冲区)时扩大缓冲区继续读取
+ */
+bool H264FileParse::FillNalus()
+{
+	if (reader)
+		return FillAsyncNalus();
 
-		realReadSize = fread(stream + left, 1, READ_BUFF_SIZE - left, fp);
+	while (true)
+	{
+		/* 将上一次解析后剩余的数据移动到前面；没有起始码(lastFrameIndex为-1)时只保留最后4个字节(可能是被分开的起始码) */
+		int tail = lastFrameIndex >= 0 ? lastFrameIndex : (realReadSize > 4 ? realReadSize - 4 : 0);
+		if (realReadSize - tail >= MAX_NALU_SIZE) // 单帧超过MAX_NALU_SIZE：丢弃，同样只保留最后4个字节
+			tail = realReadSize - 4;
+		int left = (realReadSize - tail) > 0 ? (realReadSize - tail) : 0;
+		if (left > 0 && tail > 0)
+			memmove(stream, stream + tail, left);
+		streamOffset += realReadSize - left;
+		H264_STAT_ADD(H264_STAT_MOVE_BYTES, left);
+
+		if ((size_t)left >= buffer.GetCapacity())
+			stream = buffer.Grow((size_t)left * 2, left);
+
+		/* 读取文件数据：最多使用MAX_NALU_SIZE + 4字节(一帧及下一个起始码)，更大的帧在上面丢弃，realReadSize不会超过int的范围 */
+		size_t size = buffer.GetCapacity();
+		if (size > (size_t)MAX_NALU_SIZE + 4)
+			size = (size_t)MAX_NALU_SIZE + 4;
+		int n;
+		{
+			H264_STAT_TIMER(H264_STAGE_READ);
+			n = fread(stream + left, 1, size - left, fp);
+		}
+		realReadSize = left + n;
 		if (realReadSize == 0)
 			return false;
+		if (n > 0)
+		{
+			H264_STAT_ADD(H264_STAT_REFILLS, 1);
+			H264_STAT_ADD(H264_STAT_READ_BYTES, n);
+		}
 
-		realReadSize += left;
-		Nalus = parser->GetNalusFromFrame(stream, realReadSize, &lastFrameIndex);
-		if (Nalus.size() > 0)
+		lastFrameIndex = -1;
+		Nalus = &parser.GetNalusFromFrame(stream, realReadSize, &lastFrameIndex);
+		naluIndex = 0;
+		naluCount = Nalus->size();
+
+		/* 文件结束：最后一帧也是完整的，下次调用时没有剩余数据 */
+		if (n == 0 || feof(fp))
 		{
-			nalu = Nalus[0];
-			Nalus.erase(Nalus.begin());
+			lastFrameIndex = realReadSize;
+			return naluCount > 0;
+		}
 
-			/* 将最后一帧去掉，避免重复获取，因为下次解析时会从这一帧(lastFrameIndex)开始 */
-			if ((Nalus.size() > 0) && (!feof(fp)))
-				Nalus.erase(Nalus.end() - 1);
-			
-			return true;
+		/* 将最后一帧去掉，避免重复获取，因为下次解析时会从这一帧(lastFrameIndex)开始 */
+		if (naluCount > 0)
+		{
+			naluCount--;
+			H264_STAT_NALU((*Nalus)[naluCount].type, -1);
+			H264_STAT_ADD(H264_STAT_CARRY_BYTES, realReadSize - lastFrameIndex);
 		}
+		if (naluCount > 0)
+			return true;
 	}
-
-	return false;
 }
 
-//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-// SPS帧信息解析
-NaluSpsParse::NaluSpsParse(unsigned char *sps, int len)
+/*
+ * 异步预读方式：取出下一块，上一块剩余的最后一帧拷贝到新块之前的headroom中，拼成连续的数据再解析
+ * 解析本块时后面的块已在读取；剩余的数据超过headroom(单帧大于一块)时拼接到buffer中
+ */
+bool H264FileParse::FillAsyncNalus()
 {
-	int startCodeLen = 0;
-	if (sps && len > 3)
+	while (!readerEof)
 	{
-		/* 如果包含起始码，则跳过起始码 */
-		if (sps[0] == 0 && sps[1] == 0 && sps[2] == 1)
+		int left = (realReadSize - lastFrameIndex) > 0 ? (realReadSize - lastFrameIndex) : 0;
+		if (left >= MAX_NALU_SIZE) // 单帧超过MAX_NALU_SIZE：丢弃，只保留最后4个字节，拼接后的长度不会超过int的范围
+		{
+			lastFrameIndex = realReadSize - 4;
+			left = 4;
+		}
+		unsigned char *prev = left > 0 ? stream + lastFrameIndex : NULL; // 在heldChunk归还前有效
+		unsigned char *chunk = NULL;
+		int n;
+		{
+			H264_STAT_TIMER(H264_STAGE_READ);
+			n = reader->Acquire(chunk);
+		}
+		streamOffset = readOffset - left; // 剩余数据与新块拼接后的起始位置
+		if (n <= 0)
 		{
-			startCodeLen = 3;
+			/* 文件结束(或读取错误)：剩余的数据单独解析，最后一帧不再保留 */
+			readerEof = true;
+			if (left <= 0)
+				return false;
+			stream = prev;
+			realReadSize = left;
 		}
-		else if (sps[0] == 0 && sps[1] == 0
-			&& sps[2] == 0 && sps[3] == 1)
+		else if (left <= ASYNC_READ_CHUNK_SIZE)
 		{
-			startCodeLen = 4;
+			stream = chunk - left;
+			if (left > 0)
+				memcpy(stream, prev, left);
+			realReadSize = left + n;
+			H264_STAT_ADD(H264_STAT_MOVE_BYTES, left);
+		}
+		else
+		{
+			unsigned char *data = buffer.GetData();
+			size_t keep = 0;
+			if (data && prev >= data && prev < data + buffer.GetCapacity())
+			{
+				memmove(data, prev, left);
+				keep = left;
+			}
+			data = buffer.Grow(left + n, keep);
+			if (!keep)
+				memcpy(data, prev, left);
+			memcpy(data + left, chunk, n);
+			H264_STAT_ADD(H264_STAT_MOVE_BYTES, left + n);
+			reader->Release(chunk);
+			chunk = NULL;
+			stream = data;
+			realReadSize = left + n;
 		}
 
-		length = len - startCodeLen;
-		stream = new unsigned char[length];
-		memcpy(stream, sps + startCodeLen, length);
+		/* 剩余数据已拷贝，上一块可以用于后面的读取 */
+		if (n > 0)
+		{
+			readOffset += n;
+			H264_STAT_ADD(H264_STAT_REFILLS, 1);
+			H264_STAT_ADD(H264_STAT_READ_BYTES, n);
+			if (heldChunk)
+				reader->Release(heldChunk);
+			heldChunk = chunk;
+		}
 
-		/* init bit stream */
-		bs = new BitStream(stream + 1, length - 1); // 跳过头字节
+		lastFrameIndex = 0;
+		Nalus = &parser.GetNalusFromFrame(stream, realReadSize, &lastFrameIndex);
+		naluIndex = 0;
+		naluCount = Nalus->size();
+		if (readerEof)
+			return naluCount > 0;
 
-		/* 获取SPS信息 */
-		profile_idc = bs->ReadU(8);
-		constraint_set_flag = bs->ReadU(8);
-		level_idc = bs->ReadU(8);
-		seq_parameter_set_id = bs->ReadUE1();
+		if (lastFrameIndex < 0) // 没有起始码：丢弃，只保留最后4个字节(可能是被分开的起始码)
+			lastFrameIndex = realReadSize > 4 ? realReadSize - 4 : 0;
 
-		if (profile_idc == 100 || profile_idc == 110
-			|| profile_idc == 122 || profile_idc == 244
-			|| profile_idc == 44 || profile_idc == 83
-			|| profile_idc == 86 || profile_idc == 118
-			|| profile_idc == 128 || profile_idc == 138
-			|| profile_idc == 139 || profile_idc == 134 || profile_idc == 135)
+		/* 将最后一帧去掉，下次与下一块拼接后再解析；还没有完整的一帧时继续读取 */
+		if (naluCount > 0)
 		{
-			chroma_format_idc = bs->ReadUE1();
-			if (chroma_format_idc == 3)
-			{
-				separate_colour_plane_flag = bs->ReadU1();
-				if (separate_colour_plane_flag == 0)
-					chroma_array_type = chroma_format_idc;
-			}
+			naluCount--;
+			H264_STAT_NALU((*Nalus)[naluCount].type, -1);
+			H264_STAT_ADD(H264_STAT_CARRY_BYTES, realReadSize - lastFrameIndex);
+		}
+		if (naluCount > 0)
+			return true;
+	}
+	return false;
+}
 
-			bit_depth_luma_minus8 = bs->ReadUE1();
-			bit_depth_chroma_minus8 = bs->ReadUE1();
-			qpprime_y_zero_transform_bypass_flag = bs->ReadU1();
-			seq_scaling_matrix_present_flag = bs->ReadU1();
+// 获取一帧NALU
+bool H264FileParse::GetNextNalu(Nalu &nalu)
+{
+	if (mapData)
+		return GetNextMappedNalu(nalu);
 
-			if (seq_scaling_matrix_present_flag)
-			{
-				for (int i = 0; i < (chroma_format_idc != 3) ? 8 : 12; i++)
-				{
-					seq_scaling_list_present_flag[i] = bs->ReadU1();
-				}
-			}
-		}
+	if (fp)
+	{
+		if (naluIndex >= naluCount && !FillNalus())
+			return false;
+
+		nalu = (*Nalus)[naluIndex++];
+		return true;
+	}
+
+	return false;
+}
+
+// 批量获取NALU
+int H264FileParse::GetNextNalus(Nalu *nalus, int count)
+{
+	int n = 0;
+	if (!nalus || count <= 0)
+		return 0;
+
+	if (mapData)
+	{
+		while (n < count && GetNextMappedNalu(nalus[n]))
+			n++;
+		return n;
+	}
+
+	if (fp)
+	{
+		if (naluIndex >= naluCount && !FillNalus())
+			return 0;
+
+		while (n < count && naluIndex < naluCount)
+			nalus[n++] = (*Nalus)[naluIndex++];
+	}
+	return n;
+}
+
+// 跳转到指定位置
+bool H264FileParse::Seek(unsigned long long offset)
+{
+	if (mapData)
+	{
+		if (offset >= mapSize)
+			return false;
+		const unsigned char *p = FindStartCode(mapData + offset, mapData + mapSize, &mapStartCodeLen);
+		mapPos = (p && (size_t)(p - mapData) + 4 < mapSize) ? (p - mapData) : mapSize;
+		return true;
+	}
+
+	if (reader)
+	{
+		if (heldChunk)
+			reader->Release(heldChunk);
+		heldChunk = NULL;
+		reader->Seek(offset);
+		readOffset = offset;
+		readerEof = false;
+		stream = NULL;
+		realReadSize = 0;
+		lastFrameIndex = 0;
+		naluIndex = 0;
+		naluCount = 0;
+		return true;
+	}
+
+	if (fp)
+	{
+		if (fseeko(fp, (off_t)offset, SEEK_SET) != 0)
+			return false;
+		clearerr(fp);
+		streamOffset = offset;
+		realReadSize = 0; // 丢弃已读取的数据，下一次从offset处重新读取
+		lastFrameIndex = 0;
+		naluIndex = 0;
+		naluCount = 0;
+		return true;
+	}
+
+	return false;
+}
+
+// NALU在文件中的位置
+long long H264FileParse::GetNaluOffset(const Nalu &nalu)
+{
+	const unsigned char *base = mapData ? mapData : stream;
+	size_t size = mapData ? mapSize : (realReadSize > 0 ? realReadSize : 0);
+	if (!base || !nalu.pdata || nalu.pdata < base || nalu.pdata >= base + size)
+		return -1;
+
+	/* 与FindStartCode的判断一致：起始码前面还有一个0时为4字节起始码 */
+	size_t pos = nalu.pdata - base;
+	int startCodeLen = (pos >= 4 && base[pos - 4] == 0) ? 4 : 3;
+	if (pos < (size_t)startCodeLen)
+		return -1;
+	return (long long)((mapData ? 0 : streamOffset) + pos - startCodeLen);
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// H264流解析(推模式)
+H264StreamParse::H264StreamParse(const NaluCallback &callback, H264Allocator *allocator)
+	: buffer(allocator)
+{
+	this->callback = callback;
+	stream = NULL;
+	capacity = 0;
+	length = 0;
+	startCodeIndex = -1;
+	startCodeLen = 0;
+	scanPos = 0;
+}
+
+H264StreamParse::~H264StreamParse()
+{
+	stream = NULL; // 由buffer释放
+}
+
+/* 保证缓存能再放下len字节：先丢弃已输出的数据，不够再扩容 */
+void H264StreamParse::Reserve(int len)
+{
+	/* 还没有找到起始码时，只需保留最后3个字节，用于查找跨两次输入的起始码 */
+	int keep = startCodeIndex >= 0 ? startCodeIndex : (length > 3 ? length - 3 : 0);
+	if (keep > 0 && length + len > capacity)
+	{
+		memmove(stream, stream + keep, length - keep);
+		H264_STAT_ADD(H264_STAT_MOVE_BYTES, length - keep);
+		length -= keep;
+		scanPos -= keep;
+		if (startCodeIndex >= 0)
+			startCodeIndex -= keep;
+	}
+
+	if (length + len > capacity)
+	{
+		int size = capacity > 0 ? capacity : 64 * 1024;
+		while (size < length + len)
+			size *= 2;
+		stream = buffer.Grow(size, length);
+		capacity = (int)buffer.GetCapacity();
+	}
+}
 
-		/* 确定YUV比值 */
-		if (chroma_array_type == 1)
+void H264StreamParse::Emit(unsigned char *data, int len)
+{
+	Nalu nalu;
+	nalu.SetData(data, len);
+	H264_STAT_NALU(nalu.type, 1);
+	if (callback)
+		callback(nalu);
+}
+
+// 输入数据
+void H264StreamParse::Feed(const unsigned char *data, int len)
+{
+	if (!data || len <= 0)
+		return;
+
+	Reserve(len);
+	memcpy(stream + length, data, len);
+	length += len;
+	H264_STAT_TIMER(H264_STAGE_SCAN);
+	H264_STAT_ADD(H264_STAT_MOVE_BYTES, len);
+	H264_STAT_ADD(H264_STAT_BYTES_SCANNED, length - scanPos);
+
+	/* 从上次扫描结束的位置继续查找起始码 */
+	int codeLen = 0;
+	const unsigned char *p = NULL;
+	while ((p = FindStartCode(stream + scanPos, stream + length, &codeLen)) != NULL)
+	{
+		int index = p - stream;
+
+		/* 4字节起始码的第一个0可能在上次扫描的范围内，需要补充判断 */
+		int payload = startCodeIndex >= 0 ? startCodeIndex + startCodeLen : 0;
+		if (codeLen == 3 && index > payload && stream[index - 1] == 0)
 		{
-			sub_width_c = 2;
-			sub_height_c = 2;
+			index--;
+			codeLen = 4;
 		}
-		else if (chroma_array_type == 2)
+
+		/* 找到下一个起始码，上一帧完整了 */
+		if (startCodeIndex >= 0)
+			Emit(stream + payload, index - payload);
+
+		startCodeIndex = index;
+		startCodeLen = codeLen;
+		scanPos = index + codeLen;
+	}
+
+	/* 最后2个字节可能是下一个起始码的一部分，下次从这里开始查找 */
+	if (scanPos < length - 2)
+		scanPos = length - 2;
+}
+
+// 输入结束
+void H264StreamParse::Flush()
+{
+	if (startCodeIndex >= 0)
+	{
+		int payload = startCodeIndex + startCodeLen;
+		if (length > payload)
+			Emit(stream + payload, length - payload);
+	}
+	Reset();
+}
+
+void H264StreamParse::Reset()
+{
+	length = 0;
+	startCodeIndex = -1;
+	startCodeLen = 0;
+	scanPos = 0;
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// SPS帧信息解析
+/* 跳过scaling_list()，只需要读出delta_scale以定位后面的字段 */
+static void SkipScalingList(BitStream &bs, int size)
+{
+	int lastScale = 8, nextScale = 8;
+	for (int j = 0; j < size && !bs.IsError(); j++)
+	{
+		if (nextScale != 0)
 		{
-			sub_width_c = 2;
-			sub_height_c = 1;
+			int delta_scale = bs.ReadSE();
+			nextScale = (lastScale + delta_scale + 256) % 256;
 		}
-		else if (chroma_array_type == 3)
+		lastScale = (nextScale == 0) ? lastScale : nextScale;
+	}
+}
+
+/* 默认值见各成员的初始值 */
+void SpsInfo::Reset()
+{
+	*this = SpsInfo();
+}
+
+unsigned long long HrdInfo::GetBitRate(int i) const
+{
+	if (i < 0 || i > cpb_cnt_minus1)
+		return 0;
+	return ((unsigned long long)bit_rate_value_minus1[i] + 1) << (6 + bit_rate_scale);
+}
+
+unsigned long long HrdInfo::GetCpbSize(int i) const
+{
+	if (i < 0 || i > cpb_cnt_minus1)
+		return 0;
+	return ((unsigned long long)cpb_size_value_minus1[i] + 1) << (4 + cpb_size_scale);
+}
+
+void VuiInfo::Reset()
+{
+	*this = VuiInfo();
+}
+
+/* hrd_parameters() */
+static bool ParseHrd(BitStream &bs, HrdInfo &hrd)
+{
+	hrd.cpb_cnt_minus1 = bs.ReadUE();
+	if (hrd.cpb_cnt_minus1 < 0 || hrd.cpb_cnt_minus1 >= MAX_CPB_COUNT)
+		return false;
+	hrd.bit_rate_scale = bs.ReadU(4);
+	hrd.cpb_size_scale = bs.ReadU(4);
+	for (int i = 0; i <= hrd.cpb_cnt_minus1; i++)
+	{
+		hrd.bit_rate_value_minus1[i] = (unsigned int)bs.ReadUE();
+		hrd.cpb_size_value_minus1[i] = (unsigned int)bs.ReadUE();
+		hrd.cbr_flag[i] = bs.ReadU1();
+	}
+	hrd.initial_cpb_removal_delay_length_minus1 = bs.ReadU(5);
+	hrd.cpb_removal_delay_length_minus1 = bs.ReadU(5);
+	hrd.dpb_output_delay_length_minus1 = bs.ReadU(5);
+	hrd.time_offset_length = bs.ReadU(5);
+	return !bs.IsError();
+}
+
+/* vui_parameters() */
+static bool ParseVui(BitStream &bs, VuiInfo &vui)
+{
+	vui.aspect_ratio_info_present_flag = bs.ReadU1();
+	if (vui.aspect_ratio_info_present_flag)
+	{
+		vui.aspect_ratio_idc = bs.ReadU(8);
+		if (vui.aspect_ratio_idc == 255) // Extended_SAR
 		{
-			sub_width_c = 1;
-			sub_height_c = 1;
+			vui.sar_width = bs.ReadU(16);
+			vui.sar_height = bs.ReadU(16);
 		}
+	}
 
-		log2_max_frame_num_minus4 = bs->ReadUE1();
-		pic_order_cnt_type = bs->ReadUE1();
-		if (pic_order_cnt_type == 0)
-			log2_max_pic_order_cnt_lsb_minus4 = bs->ReadUE1();
-		else if (pic_order_cnt_type == 1)
-		{
-			delta_pic_order_always_zero_flag = bs->ReadU1();
-			offset_for_non_ref_pic = bs->ReadSE1();
-			offset_for_top_to_bottom_field = bs->ReadSE1();
-			num_ref_frames_in_pic_order_cnt_cycle = bs->ReadUE1();
+	vui.overscan_info_present_flag = bs.ReadU1();
+	if (vui.overscan_info_present_flag)
+		vui.overscan_appropriate_flag = bs.ReadU1();
 
-			if (num_ref_frames_in_pic_order_cnt_cycle > 0)
-				offset_for_ref_frame = new int[num_ref_frames_in_pic_order_cnt_cycle];
-			for (int i = 0; i < num_ref_frames_in_pic_order_cnt_cycle; i++)
-				offset_for_ref_frame[i] = bs->ReadSE1();
+	vui.video_signal_type_present_flag = bs.ReadU1();
+	if (vui.video_signal_type_present_flag)
+	{
+		vui.video_format = bs.ReadU(3);
+		vui.video_full_range_flag = bs.ReadU1();
+		vui.colour_description_present_flag = bs.ReadU1();
+		if (vui.colour_description_present_flag)
+		{
+			vui.colour_primaries = bs.ReadU(8);
+			vui.transfer_characteristics = bs.ReadU(8);
+			vui.matrix_coefficients = bs.ReadU(8);
 		}
+	}
+
+	vui.chroma_loc_info_present_flag = bs.ReadU1();
+	if (vui.chroma_loc_info_present_flag)
+	{
+		vui.chroma_sample_loc_type_top_field = bs.ReadUE();
+		vui.chroma_sample_loc_type_bottom_field = bs.ReadUE();
+	}
+
+	vui.timing_info_present_flag = bs.ReadU1();
+	if (vui.timing_info_present_flag)
+	{
+		vui.num_units_in_tick = (unsigned int)bs.ReadU(32);
+		vui.time_scale = (unsigned int)bs.ReadU(32);
+		vui.fixed_frame_rate_flag = bs.ReadU1();
+	}
+
+	vui.nal_hrd_parameters_present_flag = bs.ReadU1();
+	if (vui.nal_hrd_parameters_present_flag && !ParseHrd(bs, vui.nal_hrd))
+		return false;
+	vui.vcl_hrd_parameters_present_flag = bs.ReadU1();
+	if (vui.vcl_hrd_parameters_present_flag && !ParseHrd(bs, vui.vcl_hrd))
+		return false;
+	if (vui.nal_hrd_parameters_present_flag || vui.vcl_hrd_parameters_present_flag)
+		vui.low_delay_hrd_flag = bs.ReadU1();
+
+	vui.pic_struct_present_flag = bs.ReadU1();
+	vui.bitstream_restriction_flag = bs.ReadU1();
+	if (vui.bitstream_restriction_flag)
+	{
+		vui.motion_vectors_over_pic_boundaries_flag = bs.ReadU1();
+		vui.max_bytes_per_pic_denom = bs.ReadUE();
+		vui.max_bits_per_mb_denom = bs.ReadUE();
+		vui.log2_max_mv_length_horizontal = bs.ReadUE();
+		vui.log2_max_mv_length_vertical = bs.ReadUE();
+		vui.max_num_reorder_frames = bs.ReadUE();
+		vui.max_dec_frame_buffering = bs.ReadUE();
+		if (vui.max_num_reorder_frames > vui.max_dec_frame_buffering)
+			return false;
+	}
+	return !bs.IsError();
+}
+
+static bool DoParseSps(const unsigned char *data, int len, SpsInfo &sps)
+{
+	sps.Reset();
+	if (!data || len <= 3)
+		return false;
 
-		max_num_ref_frames = bs->ReadUE1();
-		gaps_in_frame_num_value_allowed_flag = bs->ReadU1();
+	int startCodeLen = SkipStartCode(data, len);
+	BitStream bs(data + startCodeLen + 1, len - startCodeLen - 1, true); // 跳过头字节，读取时去掉防竞争字节
 
-		/* 图像宽高 */
-		pic_width_in_mbs_minus1 = bs->ReadUE1();
-		pic_height_in_map_units_minus1 = bs->ReadUE1();
+	/* 获取SPS信息 */
+	sps.profile_idc = bs.ReadU(8);
+	sps.constraint_set_flag = bs.ReadU(8);
+	sps.level_idc = bs.ReadU(8);
+	sps.seq_parameter_set_id = bs.ReadUE();
+	if (sps.seq_parameter_set_id < 0 || sps.seq_parameter_set_id >= MAX_SPS_COUNT)
+		return false;
+
+	int profile_idc = sps.profile_idc;
+	if (profile_idc == 100 || profile_idc == 110
+		|| profile_idc == 122 || profile_idc == 244
+		|| profile_idc == 44 || profile_idc == 83
+		|| profile_idc == 86 || profile_idc == 118
+		|| profile_idc == 128 || profile_idc == 138
+		|| profile_idc == 139 || profile_idc == 134 || profile_idc == 135)
+	{
+		sps.chroma_format_idc = bs.ReadUE();
+		if (sps.chroma_format_idc < 0 || sps.chroma_format_idc > 3)
+			return false;
+		if (sps.chroma_format_idc == 3)
+			sps.separate_colour_plane_flag = bs.ReadU1();
 
-		/* 确定编码方式 */
-		frame_mbs_only_flag = bs->ReadU1();
-		if (frame_mbs_only_flag == 0)
-			mb_adaptive_frame_field_flag = bs->ReadU1();
+		sps.bit_depth_luma_minus8 = bs.ReadUE();
+		sps.bit_depth_chroma_minus8 = bs.ReadUE();
+		sps.qpprime_y_zero_transform_bypass_flag = bs.ReadU1();
+		sps.seq_scaling_matrix_present_flag = bs.ReadU1();
 
-		direct_8x8_inference_flag = bs->ReadU1();
-		frame_cropping_flag = bs->ReadU1();
-		if (frame_cropping_flag)
+		if (sps.seq_scaling_matrix_present_flag)
 		{
-			frame_crop_left_offset = bs->ReadUE1();
-			frame_crop_right_offset = bs->ReadUE1();
-			frame_crop_top_offset = bs->ReadUE1();
-			frame_crop_bottom_offset = bs->ReadUE1();
+			int count = (sps.chroma_format_idc != 3) ? 8 : 12;
+			for (int i = 0; i < count; i++)
+			{
+				sps.seq_scaling_list_present_flag[i] = bs.ReadU1();
+				if (sps.seq_scaling_list_present_flag[i])
+					SkipScalingList(bs, i < 6 ? 16 : 64);
+			}
 		}
+	}
+
+	/* 确定YUV比值 */
+	sps.chroma_array_type = sps.separate_colour_plane_flag ? 0 : sps.chroma_format_idc;
+	if (sps.chroma_array_type == 1)
+	{
+		sps.sub_width_c = 2;
+		sps.sub_height_c = 2;
+	}
+	else if (sps.chroma_array_type == 2)
+	{
+		sps.sub_width_c = 2;
+		sps.sub_height_c = 1;
+	}
+	else if (sps.chroma_array_type == 3)
+	{
+		sps.sub_width_c = 1;
+		sps.sub_height_c = 1;
+	}
+
+	sps.log2_max_frame_num_minus4 = bs.ReadUE();
+	sps.pic_order_cnt_type = bs.ReadUE();
+	if (sps.log2_max_frame_num_minus4 < 0 || sps.log2_max_frame_num_minus4 > 12
+		|| sps.pic_order_cnt_type < 0 || sps.pic_order_cnt_type > 2)
+		return false;
+
+	if (sps.pic_order_cnt_type == 0)
+	{
+		sps.log2_max_pic_order_cnt_lsb_minus4 = bs.ReadUE();
+		if (sps.log2_max_pic_order_cnt_lsb_minus4 < 0 || sps.log2_max_pic_order_cnt_lsb_minus4 > 12)
+			return false;
+	}
+	else if (sps.pic_order_cnt_type == 1)
+	{
+		sps.delta_pic_order_always_zero_flag = bs.ReadU1();
+		sps.offset_for_non_ref_pic = bs.ReadSE();
+		sps.offset_for_top_to_bottom_field = bs.ReadSE();
+		sps.num_ref_frames_in_pic_order_cnt_cycle = bs.ReadUE();
+		if (sps.num_ref_frames_in_pic_order_cnt_cycle < 0
+			|| sps.num_ref_frames_in_pic_order_cnt_cycle > MAX_REF_FRAMES_IN_POC_CYCLE)
+			return false;
+
+		for (int i = 0; i < sps.num_ref_frames_in_pic_order_cnt_cycle; i++)
+			sps.offset_for_ref_frame[i] = bs.ReadSE();
+	}
+
+	sps.max_num_ref_frames = bs.ReadUE();
+	sps.gaps_in_frame_num_value_allowed_flag = bs.ReadU1();
+
+	/* 图像宽高 */
+	sps.pic_width_in_mbs_minus1 = bs.ReadUE();
+	sps.pic_height_in_map_units_minus1 = bs.ReadUE();
+
+	/* 确定编码方式 */
+	sps.frame_mbs_only_flag = bs.ReadU1();
+	if (sps.frame_mbs_only_flag == 0)
+		sps.mb_adaptive_frame_field_flag = bs.ReadU1();
+
+	/* 宽高超出表A-1所有级别的限制时拒绝，之后计算宽高、宏块数不会溢出 */
+	int widthMbs = sps.pic_width_in_mbs_minus1 + 1;
+	int heightMbs = (2 - sps.frame_mbs_only_flag) * (sps.pic_height_in_map_units_minus1 + 1);
+	if (sps.pic_width_in_mbs_minus1 < 0 || sps.pic_height_in_map_units_minus1 < 0
+		|| widthMbs > MAX_PIC_SIZE_IN_MBS || heightMbs > MAX_PIC_SIZE_IN_MBS
+		|| widthMbs * heightMbs > MAX_FRAME_SIZE_IN_MBS)
+		return false;
+
+	sps.direct_8x8_inference_flag = bs.ReadU1();
+	sps.frame_cropping_flag = bs.ReadU1();
+	if (sps.frame_cropping_flag)
+	{
+		sps.frame_crop_left_offset = bs.ReadUE();
+		sps.frame_crop_right_offset = bs.ReadUE();
+		sps.frame_crop_top_offset = bs.ReadUE();
+		sps.frame_crop_bottom_offset = bs.ReadUE();
+
+		/* 裁剪后的宽高必须大于0(7.4.2.1.1) */
+		int cropUnitX = sps.chroma_array_type == 0 ? 1 : sps.sub_width_c;
+		int cropUnitY = (sps.chroma_array_type == 0 ? 1 : sps.sub_height_c) * (2 - sps.frame_mbs_only_flag);
+		if (sps.frame_crop_left_offset < 0 || sps.frame_crop_right_offset < 0
+			|| sps.frame_crop_top_offset < 0 || sps.frame_crop_bottom_offset < 0
+			|| sps.frame_crop_left_offset > widthMbs * 16 || sps.frame_crop_right_offset > widthMbs * 16
+			|| sps.frame_crop_top_offset > heightMbs * 16 || sps.frame_crop_bottom_offset > heightMbs * 16
+			|| cropUnitX * (sps.frame_crop_left_offset + sps.frame_crop_right_offset) >= widthMbs * 16
+			|| cropUnitY * (sps.frame_crop_top_offset + sps.frame_crop_bottom_offset) >= heightMbs * 16)
+			return false;
+	}
+
+	sps.vui_parameters_present_flag = bs.ReadU1();
+	if (bs.IsError())
+		return false;
+
+	/* 有的编码器写出的VUI被截断或不规范：丢弃VUI，SPS本身仍然可用 */
+	if (sps.vui_parameters_present_flag && !ParseVui(bs, sps.vui))
+	{
+		sps.vui.Reset();
+		sps.vui_parameters_present_flag = 0;
+	}
 
-		vui_parameters_present_flag = bs->ReadU1();
+	/* 没有bitstream_restriction时的推断值(E.2.1) */
+	if (!sps.vui.bitstream_restriction_flag)
+	{
+		bool intraOnly = (profile_idc == 44 || profile_idc == 86 || profile_idc == 100
+			|| profile_idc == 110 || profile_idc == 122 || profile_idc == 244)
+			&& (sps.constraint_set_flag & 0x10); // constraint_set3_flag
+		sps.vui.max_dec_frame_buffering = intraOnly ? 0 : sps.GetMaxDpbFrames();
+		sps.vui.max_num_reorder_frames = sps.vui.max_dec_frame_buffering;
 	}
+	return true;
+}
+
+bool ParseSps(const unsigned char *data, int len, SpsInfo &sps)
+{
+	H264_STAT_TIMER(H264_STAGE_SPS);
+	bool ok = DoParseSps(data, len, sps);
+	H264_STAT_ADD(ok ? H264_STAT_SPS : H264_STAT_PARAM_ERRORS, 1);
+	return ok;
 }
 
 // 获取图像宽高信息
-bool NaluSpsParse::GetWidthHeight(int &width, int &height)
+bool SpsInfo::GetWidthHeight(int &width, int &height) const
 {
 	width = (pic_width_in_mbs_minus1 + 1) * 16;
 	height = (pic_height_in_map_units_minus1 + 1) * 16;
 	return true;
 }
 
-bool NaluSpsParse::GetRealWidthHeight(int &width, int &height)
+bool SpsInfo::GetRealWidthHeight(int &width, int &height) const
 {
 	width = (pic_width_in_mbs_minus1 + 1) * 16;
 	height = (2 - frame_mbs_only_flag) * (pic_height_in_map_units_minus1 + 1) * 16;
@@ -409,96 +1116,299 @@ bool NaluSpsParse::GetRealWidthHeight(int &width, int &height)
 	return true;
 }
 
+bool SpsInfo::GetFrameRate(double &fps) const
+{
+	fps = 0;
+	if (!vui.timing_info_present_flag || vui.num_units_in_tick == 0 || vui.time_scale == 0)
+		return false;
+	fps = vui.time_scale / (2.0 * vui.num_units_in_tick);
+	return true;
+}
+
+/* 表A-1：各级别的MaxDpbMbs */
+static int GetMaxDpbMbs(int levelIdc, bool level1b)
+{
+	switch (levelIdc)
+	{
+	case 9: return 396; // 1b
+	case 10: return 396;
+	case 11: return level1b ? 396 : 900; // Baseline/Main/Extended中level_idc=11且constraint_set3_flag=1表示1b
+	case 12: case 13: case 20: return 2376;
+	case 21: return 4752;
+	case 22: case 30: return 8100;
+	case 31: return 18000;
+	case 32: return 20480;
+	case 40: case 41: return 32768;
+	case 42: return 34816;
+	case 50: return 110400;
+	case 51: case 52: return 184320;
+	case 60: case 61: case 62: return 696320;
+	default: return 0;
+	}
+}
+
+int SpsInfo::GetMaxDpbFrames() const
+{
+	bool cs3 = (constraint_set_flag & 0x10) != 0;
+	bool level1b = (profile_idc == 66 || profile_idc == 77 || profile_idc == 88) && cs3;
+	int maxDpbMbs = GetMaxDpbMbs(level_idc, level1b);
+	int frameMbs = (pic_width_in_mbs_minus1 + 1) * (2 - frame_mbs_only_flag) * (pic_height_in_map_units_minus1 + 1);
+	if (maxDpbMbs <= 0 || frameMbs <= 0)
+		return 16;
+	int frames = maxDpbMbs / frameMbs;
+	return frames < 16 ? frames : 16;
+}
+
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // PPS帧信息解析
-NaluPpsParse::NaluPpsParse(unsigned char *pps, int len)
+void PpsInfo::Reset()
 {
-	int startCodeLen = 0;
-	if (pps && len > 3)
+	*this = PpsInfo();
+}
+
+static bool DoParsePps(const unsigned char *data, int len, PpsInfo &pps, const SpsInfo *sps)
+{
+	pps.Reset();
+	if (!data || len <= 3)
+		return false;
+
+	int startCodeLen = SkipStartCode(data, len);
+	BitStream bs(data + startCodeLen + 1, len - startCodeLen - 1, true); // 跳过头字节，读取时去掉防竞争字节
+
+	/* 解析PPS信息 */
+	pps.pic_parameter_set_id = bs.ReadUE();
+	pps.seq_parameter_set_id = bs.ReadUE();
+	if (pps.pic_parameter_set_id < 0 || pps.pic_parameter_set_id >= MAX_PPS_COUNT
+		|| pps.seq_parameter_set_id < 0 || pps.seq_parameter_set_id >= MAX_SPS_COUNT)
+		return false;
+
+	pps.entropy_coding_mode_flag = bs.ReadU1();
+	pps.bottom_field_pic_order_in_frame_present_flag = bs.ReadU1();
+	pps.num_slice_groups_minus1 = bs.ReadUE();
+	if (pps.num_slice_groups_minus1 < 0 || pps.num_slice_groups_minus1 >= MAX_SLICE_GROUPS)
+		return false;
+
+	if (pps.num_slice_groups_minus1 > 0)
 	{
-		/* 如果包含起始码，则跳过起始码 */
-		if (pps[0] == 0 && pps[1] == 0 && pps[2] == 1)
+		pps.slice_group_map_type = bs.ReadUE();
+		if (pps.slice_group_map_type == 0)
 		{
-			startCodeLen = 3;
+			for (int i = 0; i <= pps.num_slice_groups_minus1; i++)
+				pps.run_length_minus1[i] = bs.ReadUE();
 		}
-		else if (pps[0] == 0 && pps[1] == 0
-			&& pps[2] == 0 && pps[3] == 1)
+		else if (pps.slice_group_map_type == 2)
 		{
-			startCodeLen = 4;
+			for (int i = 0; i < pps.num_slice_groups_minus1; i++)
+			{
+				pps.top_left[i] = bs.ReadUE();
+				pps.bottom_right[i] = bs.ReadUE();
+			}
 		}
+		else if (pps.slice_group_map_type == 3 ||
+			pps.slice_group_map_type == 4 ||
+			pps.slice_group_map_type == 5)
+		{
+			pps.slice_group_change_direction_flag = bs.ReadU1();
+			pps.slice_group_change_rate_minus1 = bs.ReadUE();
+		}
+		else if (pps.slice_group_map_type == 6)
+		{
+			/* slice_group_id为u(v)，位数为Ceil(Log2(num_slice_groups_minus1 + 1)) */
+			int bits = 0;
+			while ((1 << bits) < pps.num_slice_groups_minus1 + 1)
+				bits++;
+			pps.pic_size_in_map_units_minus1 = bs.ReadUE();
+			if (pps.pic_size_in_map_units_minus1 < 0)
+				return false;
+			for (int i = 0; i <= pps.pic_size_in_map_units_minus1 && !bs.IsError(); i++)
+				bs.SkipU(bits);
+		}
+	}
 
-		length = len - startCodeLen;
-		stream = new unsigned char[length];
-		memcpy(stream, pps + startCodeLen, length);
-
-		/* init bit stream */
-		bs = new BitStream(stream + 1, length - 1); // 跳过头字节
-
-		/* 解析PPS信息 */
-		pic_parameter_set_id = bs->ReadUE1();
-		seq_parameter_set_id = bs->ReadUE1();
-		entropy_coding_mode_flag = bs->ReadU1();
-		bottom_field_pic_order_in_frame_present_flag = bs->ReadU1();
-		num_slice_groups_minus1 = bs->ReadUE1();
+	pps.num_ref_idx_l0_default_active_minus1 = bs.ReadUE();
+	pps.num_ref_idx_l1_default_active_minus1 = bs.ReadUE();
+	pps.weighted_pred_flag = bs.ReadU1();
+	pps.weighted_bipred_idc = bs.ReadU(2);
+	pps.pic_init_qp_minus26 = bs.ReadSE();
+	pps.pic_init_qs_minus26 = bs.ReadSE();
+	pps.chroma_qp_index_offset = bs.ReadSE();
+	pps.deblocking_filter_control_present_flag = bs.ReadU1();
+	pps.constrained_intra_pred_flag = bs.ReadU1();
+	pps.redundant_pic_cnt_present_flag = bs.ReadU1();
+	pps.second_chroma_qp_index_offset = pps.chroma_qp_index_offset;
+	if (bs.IsError())
+		return false;
 
-		if (num_slice_groups_minus1 > 0)
+	/* High profile扩展字段 */
+	if (bs.MoreRbspData())
+	{
+		pps.transform_8x8_mode_flag = bs.ReadU1();
+		pps.pic_scaling_matrix_present_flag = bs.ReadU1();
+		if (pps.pic_scaling_matrix_present_flag)
 		{
-			slice_group_map_type = bs->ReadUE1();
-			if (slice_group_map_type == 0)
+			int chroma_format_idc = sps ? sps->chroma_format_idc : 1;
+			int count = 6 + ((chroma_format_idc != 3) ? 2 : 6) * pps.transform_8x8_mode_flag;
+			for (int i = 0; i < count; i++)
 			{
-				for (int i = 0; i <= num_slice_groups_minus1; i++)
-				{
-					run_length_minus1.push_back(bs->ReadUE1());
-				}
-			}
-			else if (slice_group_map_type == 2)
-			{
-				for (int i = 0; i < num_slice_groups_minus1; i++)
-				{
-					top_left.push_back(bs->ReadUE1());
-					bottom_right.push_back(bs->ReadUE1());
-				}
-			}
-			else if (slice_group_map_type == 3 ||
-				slice_group_map_type == 4 ||
-				slice_group_map_type == 5)
-			{
-				slice_group_change_direction_flag = bs->ReadU1();
-				slice_group_change_rate_minus1 = bs->ReadUE1();
-			}
-			else if (slice_group_map_type == 6)
-			{
-				pic_size_in_map_units_minus1 = bs->ReadUE1();
-				for (int i = 0; i <= pic_size_in_map_units_minus1; i++)
-				{
-					slice_group_id.push_back(bs->ReadU(16)); // 实际应根据bit_depth读取
-				}
+				if (bs.ReadU1()) // pic_scaling_list_present_flag[i]
+					SkipScalingList(bs, i < 6 ? 16 : 64);
 			}
 		}
+		pps.second_chroma_qp_index_offset = bs.ReadSE();
+	}
+	return !bs.IsError();
+}
 
-		num_ref_idx_l0_default_active_minus1 = bs->ReadUE1();
-		num_ref_idx_l1_default_active_minus1 = bs->ReadUE1();
-		weighted_pred_flag = bs->ReadU1();
-		weighted_bipred_idc = bs->ReadU(2);
-		pic_init_qp_minus26 = bs->ReadSE1();
-		pic_init_qs_minus26 = bs->ReadSE1();
-		chroma_qp_index_offset = bs->ReadSE1();
-		deblocking_filter_control_present_flag = bs->ReadU1();
-		constrained_intra_pred_flag = bs->ReadU1();
-		redundant_pic_cnt_present_flag = bs->ReadU1();
+bool ParsePps(const unsigned char *data, int len, PpsInfo &pps, const SpsInfo *sps)
+{
+	H264_STAT_TIMER(H264_STAGE_PPS);
+	bool ok = DoParsePps(data, len, pps, sps);
+	H264_STAT_ADD(ok ? H264_STAT_PPS : H264_STAT_PARAM_ERRORS, 1);
+	return ok;
+}
 
-		if (deblocking_filter_control_present_flag)
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// SPS/PPS缓存
+/* 原始数据与缓存相同时返回true */
+static bool SameData(const std::vector<unsigned char> &cache, const unsigned char *data, int len)
+{
+	return (int)cache.size() == len && memcmp(cache.data(), data, len) == 0;
+}
+
+int ParamSetCache::Update(Nalu &nalu)
+{
+	if (nalu.GetNaluType() == NALU_TYPE_SPS)
+		return UpdateSps(nalu.GetData(), nalu.GetLength());
+	if (nalu.GetNaluType() == NALU_TYPE_PPS)
+		return UpdatePps(nalu.GetData(), nalu.GetLength());
+	return -1;
+}
+
+int ParamSetCache::UpdateSps(const unsigned char *data, int len)
+{
+	if (!data || len <= 3)
+		return -1;
+	int startCodeLen = SkipStartCode(data, len);
+	data += startCodeLen;
+	len -= startCodeLen;
+	if (len <= 4 || (data[0] & 0x1f) != NALU_TYPE_SPS)
+		return -1;
+
+	/* 先取出seq_parameter_set_id(在profile_idc、constraint_set_flag、level_idc之后)，内容相同则不再解析 */
+	BitStream bs(data + 1, len - 1, true);
+	bs.SkipU(24);
+	int id = bs.ReadUE();
+	if (bs.IsError() || id < 0 || id >= MAX_SPS_COUNT)
+		return -1;
+	if (spsPresent[id] && SameData(spsData[id], data, len))
+	{
+		H264_STAT_ADD(H264_STAT_PARAM_CACHE_HITS, 1);
+		return 0;
+	}
+
+	SpsInfo info;
+	if (!ParseSps(data, len, info))
+		return -1;
+	sps[id] = info;
+	spsData[id].assign(data, data + len);
+	spsPresent[id] = true;
+	spsGeneration[id]++;
+	generation++;
+
+	/* 引用该SPS的PPS按新的SPS重新解析(pic_scaling_matrix依赖chroma_format_idc)，解析失败的PPS删除 */
+	for (int i = 0; i < MAX_PPS_COUNT; i++)
+	{
+		if (!ppsPresent[i] || pps[i].seq_parameter_set_id != id)
+			continue;
+		PpsInfo ppsInfo;
+		if (ParsePps(ppsData[i].data(), (int)ppsData[i].size(), ppsInfo, &sps[id]))
 		{
-			disable_deblocking_filter_idc = bs->ReadUE1();
-			if (disable_deblocking_filter_idc != 1)
-			{
-				slice_alpha_c0_offset_div2 = bs->ReadSE1();
-				slice_beta_offset_div2 = bs->ReadSE1();
-			}
+			pps[i] = ppsInfo;
+			ppsGeneration[i]++;
+		}
+		else
+		{
+			ppsPresent[i] = false;
+			ppsData[i].clear();
+			generation++;
 		}
 	}
+	return 1;
 }
 
+int ParamSetCache::UpdatePps(const unsigned char *data, int len)
+{
+	if (!data || len <= 3)
+		return -1;
+	int startCodeLen = SkipStartCode(data, len);
+	data += startCodeLen;
+	len -= startCodeLen;
+	if (len <= 1 || (data[0] & 0x1f) != NALU_TYPE_PPS)
+		return -1;
+
+	BitStream bs(data + 1, len - 1, true);
+	int id = bs.ReadUE();
+	int spsId = bs.ReadUE();
+	if (bs.IsError() || id < 0 || id >= MAX_PPS_COUNT)
+		return -1;
+	if (ppsPresent[id] && SameData(ppsData[id], data, len))
+	{
+		H264_STAT_ADD(H264_STAT_PARAM_CACHE_HITS, 1);
+		return 0;
+	}
+
+	/* pic_scaling_matrix依赖SPS的chroma_format_idc */
+	PpsInfo info;
+	if (!ParsePps(data, len, info, GetSps(spsId)))
+		return -1;
+	pps[id] = info;
+	ppsData[id].assign(data, data + len);
+	ppsPresent[id] = true;
+	ppsGeneration[id]++;
+	generation++;
+	return 1;
+}
+
+const SpsInfo *ParamSetCache::GetSps(int id)
+{
+	if (id < 0 || id >= MAX_SPS_COUNT || !spsPresent[id])
+		return NULL;
+	return &sps[id];
+}
+
+const PpsInfo *ParamSetCache::GetPps(int id)
+{
+	if (id < 0 || id >= MAX_PPS_COUNT || !ppsPresent[id])
+		return NULL;
+	return &pps[id];
+}
+
+bool ParamSetCache::GetParamSets(int ppsId, const PpsInfo *&pps, const SpsInfo *&sps)
+{
+	pps = GetPps(ppsId);
+	sps = pps ? GetSps(pps->seq_parameter_set_id) : NULL;
+	return pps && sps;
+}
+
+void ParamSetCache::Clear()
+{
+	for (int i = 0; i < MAX_SPS_COUNT; i++)
+	{
+		if (spsPresent[i])
+			generation++;
+		spsPresent[i] = false;
+		spsData[i].clear();
+	}
+	for (int i = 0; i < MAX_PPS_COUNT; i++)
+	{
+		if (ppsPresent[i])
+			generation++;
+		ppsPresent[i] = false;
+		ppsData[i].clear();
+	}
+}
+
+
 
 
 
@@ -9,6 +9,9 @@
 #include <stdio.h>
 #include <vector>
 #include <string>
+#include <functional>
+#include "easy_h264_scan.h"
+#include "easy_h264_alloc.h"
 using namespace std;
 
 // 帧类型
@@ -25,16 +28,26 @@ using namespace std;
 #define NALU_TYPE_EOSTREAM 11
 #define NALU_TYPE_FILL 12
 #define READ_BUFF_SIZE (512*1024)
+#define MAX_NALU_SIZE (1 << 30) // H264FileParse的单个NALU的最大长度(Nalu的长度为int)，超过时丢弃
+
+// H264FileParse读取方式
+#define H264_FILE_READ_BUFFERED 0 // fread分块读取
+#define H264_FILE_READ_MMAP 1 // mmap映射整个文件，管道等无法映射的输入自动退回分块读取
+#define H264_FILE_READ_ASYNC 2 // 异步预读(io_uring或线程+pread)，解析当前块时后面的块已在读取；非普通文件及小文件自动退回分块读取
 
 
 // 位操作：用于解析SPS帧信息
+// 64位缓存读取，每次按整字补充；读取越界时返回0并置错误标志
+// ebsp为true时，buf为EBSP，补充缓存时跳过防竞争字节，读到的是RBSP，无需先转换整个NALU
 class BitStream
 {
 public:
 	BitStream() = delete;
-	BitStream(unsigned char *buf, int len)
+	BitStream(const unsigned char *buf, int len, bool ebsp = false)
 	{
-		start = buf; p = buf; size = len;
+		start = buf; p = buf; size = len > 0 ? len : 0;
+		end = buf + size;
+		this->ebsp = ebsp;
 	}
 	~BitStream()
 	{}
@@ -42,9 +55,12 @@ public:
 	/* 读取1bit */
 	int ReadU1();
 
-	/* 读取n个bit */
+	/* 读取n个bit，n最大为32 */
 	int ReadU(int n);
 
+	/* 跳过n个bit */
+	void SkipU(int n);
+
 	/* 解码：无符号指数哥伦布熵编码 */
 	int ReadUE();
 
@@ -57,14 +73,45 @@ public:
 	/* 解码：有符号指数哥伦布熵编码，与ReadSE()功能一样 */
 	int ReadSE1();
 
+	/* more_rbsp_data()：当前位置到rbsp_stop_one_bit之间是否还有数据 */
+	bool MoreRbspData();
+
+	/* 是否发生过越界读取或非法的指数哥伦布码 */
+	bool IsError()
+	{
+		return error;
+	}
+
+	/* 已读取的bit数，EBSP模式下不含防竞争字节，即在RBSP中的位置 */
+	int GetBitPos()
+	{
+		return (int)(p - start - epb_count) * 8 - cache_bits;
+	}
+
+	/* 剩余未读取的bit数，EBSP模式下包含尚未跳过的防竞争字节 */
+	int GetBitsLeft()
+	{
+		return (int)(end - p) * 8 + cache_bits;
+	}
+
 private:
-	unsigned char *start = 0; // ptr of buffer
+	void Refill();
+	void RefillEbsp();
+
+	const unsigned char *start = 0; // ptr of buffer
+	const unsigned char *end = 0;
 	int size = 0; // length of buffer in byte
-	unsigned char *p = 0; // 当前读取的字节
-	int bits_left = 8; // 当前字节中的第几位
+	const unsigned char *p = 0; // 下一个要装入缓存的字节
+	unsigned long long cache = 0; // 位缓存，高位对齐，有效位之后全为0
+	int cache_bits = 0; // 缓存中有效的bit数
+	bool error = false;
+	bool ebsp = false; // 是否需要跳过防竞争字节
+	int zeros = 0; // EBSP模式：最近装入的连续0x00个数(最多记2个)
+	int epb_count = 0; // EBSP模式：已跳过的防竞争字节数
 };
 
 // NALU：不包含起始码
+// Nalu不持有数据，只是指向某块缓冲区的视图(指针+长度)，缓冲区由产生它的解析器或调用者管理
 typedef struct Nalu
 {
 	/* EBSP:不包含起始码;RBSP:EBSP去掉防竞争字节;SODB:RBSP去掉补齐数据 */
@@ -116,38 +163,27 @@ typedef struct Nalu
 		}
 	}
 
-	/* RBSP:EBSP去掉防竞争字节 */
+	/* RBSP:EBSP去掉防竞争字节，rbsp可以重复使用以避免每次分配内存 */
 	bool GetRBSP(std::vector<unsigned char> &rbsp)
 	{
 		if (!pdata || length <= 3)
 			return false;
-		rbsp.clear();
-		for (int i = 0; i < length; i++)
-		{
-			if (pdata[i] == 0x03)
-			{
-				if (i > 2) // 检查前面2个字节是否是 0x00 0x00
-				{
-					if (pdata[i - 1] == 0x00 && pdata[i - 2] == 0x00)
-					{
-						if (i < length - 1) // 检查后一个字节是否是 0x00 0x01 0x02 0x03
-						{
-							if (pdata[i + 1] == 0x00
-								|| pdata[i + 1] == 0x01
-								|| pdata[i + 1] == 0x02
-								|| pdata[i + 1] == 0x03)
-							{
-								continue; // 这个是防竞争字节
-							}
-						}
-					}
-				}
-			}
-			rbsp.push_back(pdata[i]);
-		}
+		rbsp.resize(length);
+		rbsp.resize(EbspToRbsp(pdata, length, rbsp.data()));
 		return true;
 	}
 
+	/*
+	 * RBSP写入调用者提供的缓冲区，size至少为GetLength()，返回RBSP长度，失败返回-1
+	 * epbPos用于记录防竞争字节在EBSP中的位置，参见EbspToRbsp
+	 */
+	int GetRBSP(unsigned char *rbsp, int size, int *epbPos = 0, int epbMax = 0)
+	{
+		if (!pdata || length <= 3 || !rbsp || size < length)
+			return -1;
+		return EbspToRbsp(pdata, length, rbsp, epbPos, epbMax);
+	}
+
 	unsigned char *pdata;
 	int length;
 	int type, forbidden_bit, nal_ref_idc;
@@ -164,46 +200,308 @@ typedef struct StartCodeInfo
 class NaluParse
 {
 public:
-	NaluParse()
+	/*
+	 * zeroCopy为false时，先拷贝输入数据，返回的Nalu指向内部缓冲区，在下一次解析或对象析构前有效
+	 * zeroCopy为true时，不拷贝输入数据，返回的Nalu直接指向调用者的h264Frame，
+	 * 调用者必须保证h264Frame在Nalu使用期间有效且不被修改
+	 * 拷贝用的缓冲区由allocator分配(NULL时使用默认分配器)，在多次解析之间重复使用
+	 */
+	explicit NaluParse(bool zeroCopy = false, H264Allocator *allocator = NULL)
+		: stream(allocator)
 	{
-		stream = 0; len = 0; Nalus.clear();
+		Nalus.clear();
+		this->zeroCopy = zeroCopy;
 	}
 	~NaluParse()
-	{
-		if (stream) delete stream;
-	}
+	{}
+
+	NaluParse(const NaluParse &b) = delete;
+	NaluParse &operator=(const NaluParse &b) = delete;
 
 	/* 解析h264流 */
 	std::vector<Nalu> &GetNalusFromFrame(const unsigned char *h264Frame, const int h264FrameLen, int *lastFrameIndex = 0);
 
+	bool IsZeroCopy()
+	{
+		return zeroCopy;
+	}
+
 private:
-	unsigned char *stream;
-	int len;
+	bool zeroCopy; // 是否直接引用调用者的缓冲区
+	ScratchBuffer stream; // zeroCopy为false时保存输入数据的拷贝
 	std::vector<Nalu> Nalus; // EBSP:不包含起始码;RBSP:EBSP去掉防竞争字节;SODB:RBSP去掉补齐数据
 };
 
+class H264AsyncReader;
+
 // H264文件解析
 class H264FileParse
 {
 public:
 	H264FileParse() = delete;
-	H264FileParse(const std::string &filename);
+	/* allocator用于分块读取及异步预读方式的读取缓冲区，NULL时使用默认分配器；大量实例时可以使用GetSharedSlabPool() */
+	H264FileParse(const std::string &filename, int readMode = H264_FILE_READ_MMAP, H264Allocator *allocator = NULL);
 	~H264FileParse();
 
+	/*
+	 * 获取一帧NALU
+	 * mmap方式下nalu指向文件映射，在对象析构前一直有效；分块读取及异步预读方式下在下一次调用前有效
+	 */
 	bool GetNextNalu(Nalu &nalu);
 
+	/*
+	 * 批量获取NALU，最多count个，返回实际获取的个数，0表示已结束
+	 * 分块读取方式下一次只返回当前块中剩余的NALU，保证返回的nalus在下一次调用前同时有效
+	 */
+	int GetNextNalus(Nalu *nalus, int count);
+
+	/*
+	 * 跳转到文件中的offset处，从该位置开始的第一个起始码继续读取，之前的数据丢弃
+	 * offset通常来自索引文件(参见easy_h264_index.h)，超出文件大小时返回false
+	 */
+	bool Seek(unsigned long long offset);
+
+	/*
+	 * nalu起始码在文件中的位置，可以直接传给Seek
+	 * nalu必须是最近一次GetNextNalu/GetNextNalus取出的(分块读取方式下数据仍在当前块中)，否则返回-1
+	 */
+	long long GetNaluOffset(const Nalu &nalu);
+
+	/* 是否实际使用了mmap方式 */
+	bool IsMapped()
+	{
+		return mapData != NULL;
+	}
+
+	H264FileParse(const H264FileParse &b) = delete;
 	H264FileParse &operator=(const H264FileParse &b) = delete;
 
 private:
+	bool MapFile();
+	bool GetNextMappedNalu(Nalu &nalu);
+	bool FillNalus();
+	bool FillAsyncNalus();
+
 	FILE *fp;
-	NaluParse *parser;
+	NaluParse parser;
+	ScratchBuffer buffer; // 分块读取缓冲区
 	unsigned char *stream;
 
-	int realReadSize; // 上一次实际读取的字节数
-	int lastFrameIndex; // 上一次解析的最后一帧的起始位置
-	std::vector<Nalu> Nalus;
+	int realReadSize; // stream中的字节数(上一次剩余的数据加上本次读取的数据)
+	int lastFrameIndex; // 上一次解析的最后一帧的起始位置，-1表示没有起始码
+	std::vector<Nalu> *Nalus; // 指向parser的解析结果，不拷贝
+	int naluIndex; // 下一个待取出的NALU下标
+	int naluCount; // 本块中可取出的NALU个数(不含留到下一块的最后一帧)
+	unsigned long long streamOffset; // stream[0]在文件中的位置
+	unsigned long long readOffset; // 异步预读方式：下一块数据在文件中的位置
+
+	unsigned char *mapData; // 文件映射地址
+	size_t mapSize; // 文件大小
+	size_t mapPos; // 下一帧起始码的位置，等于mapSize表示已结束
+	int mapStartCodeLen; // 下一帧起始码的长度
+
+	H264AsyncReader *reader; // 异步预读
+	unsigned char *heldChunk; // 当前正在解析的块，取出下一块并拷贝剩余数据后才归还
+	bool readerEof;
 };
 
+// NALU回调：nalu指向解析器内部缓冲区，只在回调期间有效
+typedef std::function<void(Nalu &nalu)> NaluCallback;
+
+// H264流解析(推模式)：用于网络接收等数据分多次到达的场景
+class H264StreamParse
+{
+public:
+	H264StreamParse() = delete;
+	/* allocator用于流缓存，NULL时使用默认分配器 */
+	H264StreamParse(const NaluCallback &callback, H264Allocator *allocator = NULL);
+	~H264StreamParse();
+
+	/* 输入数据，每找到一个新的起始码就通过回调输出上一帧，已扫描过的数据不会重复扫描 */
+	void Feed(const unsigned char *data, int len);
+
+	/* 输入结束，输出缓存中的最后一帧，之后可以继续输入新的流 */
+	void Flush();
+
+	/* 丢弃缓存的数据，重新开始 */
+	void Reset();
+
+	H264StreamParse(const H264StreamParse &b) = delete;
+	H264StreamParse &operator=(const H264StreamParse &b) = delete;
+
+private:
+	void Reserve(int len);
+	void Emit(unsigned char *data, int len);
+
+	NaluCallback callback;
+	ScratchBuffer buffer;
+	unsigned char *stream; // 缓存：从当前帧的起始码开始到已输入数据的末尾
+	int capacity;
+	int length;
+	int startCodeIndex; // 当前帧起始码的位置，-1表示还没有找到起始码
+	int startCodeLen;
+	int scanPos; // 下一次查找起始码的位置，之前的数据已扫描过
+};
+
+#define MAX_SPS_COUNT 32 // seq_parameter_set_id取值范围0~31
+#define MAX_PPS_COUNT 256 // pic_parameter_set_id取值范围0~255
+#define MAX_REF_FRAMES_IN_POC_CYCLE 255 // num_ref_frames_in_pic_order_cnt_cycle最大值
+#define MAX_SLICE_GROUPS 8 // num_slice_groups_minus1最大为7
+#define MAX_CPB_COUNT 32 // cpb_cnt_minus1最大为31
+#define MAX_FRAME_SIZE_IN_MBS 139264 // 表A-1中MaxFS的最大值(level 6.x)，图像宏块数的上限
+#define MAX_PIC_SIZE_IN_MBS 1055 // 图像宽或高(宏块)的上限：Sqrt(MaxFS * 8)
+
+// HRD参数(E.1.2)
+typedef struct HrdInfo
+{
+	/* 第i个CPB的码率(bit/s)及缓冲区大小(bit) */
+	unsigned long long GetBitRate(int i) const;
+	unsigned long long GetCpbSize(int i) const;
+
+	int cpb_cnt_minus1 = 0;                       // ue(v)
+	int bit_rate_scale = 0;                       // u(4)
+	int cpb_size_scale = 0;                       // u(4)
+	unsigned int bit_rate_value_minus1[MAX_CPB_COUNT] = {}; // ue(v)
+	unsigned int cpb_size_value_minus1[MAX_CPB_COUNT] = {}; // ue(v)
+	unsigned char cbr_flag[MAX_CPB_COUNT] = {};   // u(1)
+	int initial_cpb_removal_delay_length_minus1 = 0; // u(5)
+	int cpb_removal_delay_length_minus1 = 0;      // u(5)
+	int dpb_output_delay_length_minus1 = 0;       // u(5)
+	int time_offset_length = 0;                   // u(5)
+}HrdInfo;
+
+// VUI参数(E.1.1)：不存在的字段为规范规定的推断值
+typedef struct VuiInfo
+{
+	/* 恢复默认值(推断值) */
+	void Reset();
+
+	unsigned char aspect_ratio_info_present_flag = 0; // u(1)
+	int aspect_ratio_idc = 0;                     // u(8)，255为Extended_SAR
+	int sar_width = 0, sar_height = 0;            // u(16)
+	unsigned char overscan_info_present_flag = 0; // u(1)
+	unsigned char overscan_appropriate_flag = 0;  // u(1)
+	unsigned char video_signal_type_present_flag = 0; // u(1)
+	int video_format = 5;                         // u(3)，默认5
+	unsigned char video_full_range_flag = 0;      // u(1)
+	unsigned char colour_description_present_flag = 0; // u(1)
+	int colour_primaries = 2;                     // u(8)，默认2
+	int transfer_characteristics = 2;             // u(8)，默认2
+	int matrix_coefficients = 2;                  // u(8)，默认2
+	unsigned char chroma_loc_info_present_flag = 0; // u(1)
+	int chroma_sample_loc_type_top_field = 0;     // ue(v)
+	int chroma_sample_loc_type_bottom_field = 0;  // ue(v)
+	unsigned char timing_info_present_flag = 0;   // u(1)
+	unsigned int num_units_in_tick = 0;           // u(32)
+	unsigned int time_scale = 0;                  // u(32)
+	unsigned char fixed_frame_rate_flag = 0;      // u(1)
+	unsigned char nal_hrd_parameters_present_flag = 0; // u(1)
+	HrdInfo nal_hrd;
+	unsigned char vcl_hrd_parameters_present_flag = 0; // u(1)
+	HrdInfo vcl_hrd;
+	unsigned char low_delay_hrd_flag = 0;         // u(1)
+	unsigned char pic_struct_present_flag = 0;    // u(1)
+	unsigned char bitstream_restriction_flag = 0; // u(1)
+	unsigned char motion_vectors_over_pic_boundaries_flag = 1; // u(1)，默认1
+	int max_bytes_per_pic_denom = 2;              // ue(v)，默认2
+	int max_bits_per_mb_denom = 1;                // ue(v)，默认1
+	int log2_max_mv_length_horizontal = 15;       // ue(v)，默认15
+	int log2_max_mv_length_vertical = 15;         // ue(v)，默认15
+	int max_num_reorder_frames = -1;              // ue(v)，不存在时由ParseSps按MaxDpbFrames推断，-1为未知
+	int max_dec_frame_buffering = -1;             // ue(v)，同上
+}VuiInfo;
+
+// SPS参数：值类型，解析过程不分配内存
+typedef struct SpsInfo
+{
+	/* 恢复默认值 */
+	void Reset();
+
+	/* 获取图像宽高信息(宏块对齐) */
+	bool GetWidthHeight(int &width, int &height) const;
+
+	/* 获取裁剪后的实际宽高 */
+	bool GetRealWidthHeight(int &width, int &height) const;
+
+	/* 帧率：VUI中有timing_info时返回true，fps = time_scale / (2 * num_units_in_tick) */
+	bool GetFrameRate(double &fps) const;
+
+	/* 级别限制的DPB最大帧数(A.3.1 MaxDpbFrames)，级别未知时返回16 */
+	int GetMaxDpbFrames() const;
+
+	unsigned char profile_idc = 0;
+	unsigned char constraint_set_flag = 0;
+	unsigned char level_idc = 0;
+	int seq_parameter_set_id = 0;
+	int chroma_format_idc = 1; // 码流格式，0：Y，1：YUV420，2：YUV422，3：YUV444
+	unsigned char separate_colour_plane_flag = 0; // 0: UV依附于Y，1：UV与Y分开编码
+	int bit_depth_luma_minus8 = 0;
+	int bit_depth_chroma_minus8 = 0;
+	unsigned char qpprime_y_zero_transform_bypass_flag = 0;
+	unsigned char seq_scaling_matrix_present_flag = 0;
+	unsigned char seq_scaling_list_present_flag[12] = {};
+	int log2_max_frame_num_minus4 = 0;
+	int pic_order_cnt_type = 0;
+	int log2_max_pic_order_cnt_lsb_minus4 = 0;
+	unsigned char delta_pic_order_always_zero_flag = 0;
+	int offset_for_non_ref_pic = 0, offset_for_top_to_bottom_field = 0;
+	int num_ref_frames_in_pic_order_cnt_cycle = 0;
+	int offset_for_ref_frame[MAX_REF_FRAMES_IN_POC_CYCLE] = {};
+	int max_num_ref_frames = 0;
+	unsigned char gaps_in_frame_num_value_allowed_flag = 0;
+	int pic_width_in_mbs_minus1 = -1, pic_height_in_map_units_minus1 = -1;
+	unsigned char frame_mbs_only_flag = 1; // 1：帧编码，0：场编码
+	unsigned char mb_adaptive_frame_field_flag = 0;
+	unsigned char direct_8x8_inference_flag = 0, frame_cropping_flag = 0;
+	int frame_crop_left_offset = 0, frame_crop_right_offset = 0;
+	int frame_crop_top_offset = 0, frame_crop_bottom_offset = 0;
+	unsigned char vui_parameters_present_flag = 0; // VUI不完整时按不存在处理，SPS本身仍然有效
+	VuiInfo vui;
+	int chroma_array_type = 1;
+	int sub_width_c = 2, sub_height_c = 2; // 表示YUV分量中，Y分量和UV分量在水平和竖直方向上的比值
+}SpsInfo;
+
+// PPS参数：值类型，解析过程不分配内存
+typedef struct PpsInfo
+{
+	/* 恢复默认值 */
+	void Reset();
+
+	int pic_parameter_set_id = 0;                 // ue(v)
+	int seq_parameter_set_id = 0;                 // ue(v)
+	bool entropy_coding_mode_flag = false;        // u(1)
+	bool bottom_field_pic_order_in_frame_present_flag = false; // u(1)
+	int num_slice_groups_minus1 = 0;              // ue(v)
+	int slice_group_map_type = 0;                 // ue(v)
+	int run_length_minus1[MAX_SLICE_GROUPS] = {}; // ue(v)
+	int top_left[MAX_SLICE_GROUPS] = {};          // ue(v)
+	int bottom_right[MAX_SLICE_GROUPS] = {};      // ue(v)
+	int slice_group_change_direction_flag = 0;    // u(1)
+	int slice_group_change_rate_minus1 = 0;       // ue(v)
+	int pic_size_in_map_units_minus1 = 0;         // ue(v)，其后的slice_group_id按位数跳过，不保存
+	int num_ref_idx_l0_default_active_minus1 = 0; // ue(v)
+	int num_ref_idx_l1_default_active_minus1 = 0; // ue(v)
+	bool weighted_pred_flag = false;              // u(1)
+	int weighted_bipred_idc = 0;                  // u(2)
+	int pic_init_qp_minus26 = 0;                  // se(v)
+	int pic_init_qs_minus26 = 0;                  // se(v)
+	int chroma_qp_index_offset = 0;               // se(v)
+	bool deblocking_filter_control_present_flag = false; // u(1)
+	bool constrained_intra_pred_flag = false;     // u(1)
+	bool redundant_pic_cnt_present_flag = false; // u(1)
+	bool transform_8x8_mode_flag = false;         // u(1)，more_rbsp_data()时存在
+	bool pic_scaling_matrix_present_flag = false; // u(1)
+	int second_chroma_qp_index_offset = 0;        // se(v)，不存在时等于chroma_qp_index_offset
+}PpsInfo;
+
+/*
+ * 解析SPS/PPS，data可以包含起始码，必须包含NALU头字节，按EBSP读取
+ * 成功返回true；数据不足或取值超出规范范围时返回false
+ * PPS中的pic_scaling_matrix依赖SPS的chroma_format_idc，sps为NULL时按4:2:0处理
+ */
+bool ParseSps(const unsigned char *data, int len, SpsInfo &sps);
+bool ParsePps(const unsigned char *data, int len, PpsInfo &pps, const SpsInfo *sps = 0);
+
 // SPS帧信息解析
 class NaluSpsParse
 {
@@ -235,69 +533,56 @@ class NaluSpsParse
 	*/
 public:
 	NaluSpsParse() = delete;
-	NaluSpsParse(unsigned char *sps, int len);
+	NaluSpsParse(unsigned char *sps, int len)
+	{
+		valid = ParseSps(sps, len, info);
+	}
 
 	~NaluSpsParse()
+	{}
+
+	NaluSpsParse &operator=(const NaluSpsParse &b) = delete;
+
+	/* 是否解析成功 */
+	bool IsValid()
 	{
-		if (stream) delete stream; stream = 0;
-		if (bs) delete bs; bs = 0;
-		if (offset_for_ref_frame) delete offset_for_ref_frame; offset_for_ref_frame = 0;
+		return valid;
 	}
 
-	NaluSpsParse &operator=(const NaluSpsParse &b) = delete;
+	/* 获取全部SPS参数 */
+	const SpsInfo &GetSpsInfo()
+	{
+		return info;
+	}
 
 	unsigned char GetProfileIdc()
 	{
-		return profile_idc;
+		return info.profile_idc;
 	}
 
 	unsigned char GetLevelIdc()
 	{
-		return level_idc;
+		return info.level_idc;
 	}
 
 	unsigned char GetChromaFormatIdc()
 	{
-		return chroma_format_idc;
+		return info.chroma_format_idc;
 	}
 
-	bool GetWidthHeight(int &width, int &height);
+	bool GetWidthHeight(int &width, int &height)
+	{
+		return info.GetWidthHeight(width, height);
+	}
 
-	bool GetRealWidthHeight(int &width, int &height);
+	bool GetRealWidthHeight(int &width, int &height)
+	{
+		return info.GetRealWidthHeight(width, height);
+	}
 
 private:
-	BitStream *bs = 0;
-	unsigned char *stream = 0;
-	int length = 0;
-	unsigned char profile_idc = 0;
-	unsigned char constraint_set_flag = 0;
-	unsigned char level_idc = 0;
-	int seq_parameter_set_id;
-	int chroma_format_idc = 1; // 码流格式，0：Y，1：YUV420，2：YUV422，3：YUV444
-	unsigned char separate_colour_plane_flag = 0; // 0: UV依附于Y，1：UV与Y分开编码
-	int bit_depth_luma_minus8 = 0;
-	int bit_depth_chroma_minus8 = 0;
-	unsigned char qpprime_y_zero_transform_bypass_flag = 0;
-	unsigned char seq_scaling_matrix_present_flag = 0;
-	unsigned char seq_scaling_list_present_flag[12];
-	int log2_max_frame_num_minus4 = 0;
-	int pic_order_cnt_type = 0;
-	int log2_max_pic_order_cnt_lsb_minus4 = 0;
-	unsigned char delta_pic_order_always_zero_flag = 0;
-	int offset_for_non_ref_pic = 0, offset_for_top_to_bottom_field = 0;
-	int num_ref_frames_in_pic_order_cnt_cycle = 0;
-	int *offset_for_ref_frame = 0;
-	int max_num_ref_frames;
-	unsigned char gaps_in_frame_num_value_allowed_flag;
-	int pic_width_in_mbs_minus1 = -1, pic_height_in_map_units_minus1 = -1;
-	unsigned char frame_mbs_only_flag = 1; // 1：帧编码，0：场编码
-	unsigned char mb_adaptive_frame_field_flag;
-	unsigned char direct_8x8_inference_flag, frame_cropping_flag;
-	int frame_crop_left_offset = 0, frame_crop_right_offset = 0;
-	int frame_crop_top_offset = 0, frame_crop_bottom_offset = 0;
-	unsigned char vui_parameters_present_flag;
-	int chroma_array_type = 0;
-	int sub_width_c = 2, sub_height_c = 2; // 表示YUV分量中，Y分量和UV分量在水平和竖直方向上的比值
+	SpsInfo info;
+	bool valid;
 };
 
 // PPS帧信息解析
@@ -305,124 +590,184 @@ class NaluPpsParse
 {
 public:
 	NaluPpsParse() = delete;
-	NaluPpsParse(unsigned char *pps, int len);
+	NaluPpsParse(unsigned char *pps, int len, const SpsInfo *sps = 0)
+	{
+		valid = ParsePps(pps, len, info, sps);
+	}
 
 	~NaluPpsParse()
+	{}
+
+	NaluPpsParse &operator=(const NaluPpsParse &b) = delete;
+
+	/* 是否解析成功 */
+	bool IsValid()
+	{
+		return valid;
+	}
+
+	/* 获取全部PPS参数 */
+	const PpsInfo &GetPpsInfo()
 	{
-		if (stream) delete stream;
-		if (bs) delete bs;
+		return info;
 	}
 
 	// 获取PPS参数
 	int GetPicParameterSetId()
 	{
-		return pic_parameter_set_id;
+		return info.pic_parameter_set_id;
 	}
 	int GetSeqParameterSetId()
 	{
-		return seq_parameter_set_id;
+		return info.seq_parameter_set_id;
 	}
 	bool GetEntropyCodingModeFlag()
 	{
-		return entropy_coding_mode_flag;
+		return info.entropy_coding_mode_flag;
 	}
 	bool GetBottomFieldPicOrderInFramePresentFlag()
 	{
-		return bottom_field_pic_order_in_frame_present_flag;
+		return info.bottom_field_pic_order_in_frame_present_flag;
 	}
 	int GetNumSliceGroupsMinus1()
 	{
-		return num_slice_groups_minus1;
+		return info.num_slice_groups_minus1;
 	}
 	int GetSliceGroupMapType()
 	{
-		return slice_group_map_type;
+		return info.slice_group_map_type;
 	}
 	int GetNumRefIdxL0DefaultActiveMinus1()
 	{
-		return num_ref_idx_l0_default_active_minus1;
+		return info.num_ref_idx_l0_default_active_minus1;
 	}
 	int GetNumRefIdxL1DefaultActiveMinus1()
 	{
-		return num_ref_idx_l1_default_active_minus1;
+		return info.num_ref_idx_l1_default_active_minus1;
 	}
 	bool GetWeightedPredFlag()
 	{
-		return weighted_pred_flag;
+		return info.weighted_pred_flag;
 	}
 	int GetWeightedBipredIdc()
 	{
-		return weighted_bipred_idc;
+		return info.weighted_bipred_idc;
 	}
 	int GetPicInitQpMinus26()
 	{
-		return pic_init_qp_minus26;
+		return info.pic_init_qp_minus26;
 	}
 	int GetPicInitQsMinus26()
 	{
-		return pic_init_qs_minus26;
+		return info.pic_init_qs_minus26;
 	}
 	int GetChromaQpIndexOffset()
 	{
-		return chroma_qp_index_offset;
+		return info.chroma_qp_index_offset;
 	}
 	bool GetDeblockingFilterControlPresentFlag()
 	{
-		return deblocking_filter_control_present_flag;
+		return info.deblocking_filter_control_present_flag;
 	}
+	/* 以下3个字段属于slice头，PPS中不存在，保留接口兼容，始终返回0 */
 	int GetDisableDeblockingFilterIdc()
 	{
-		return disable_deblocking_filter_idc;
+		return 0;
 	}
 	int GetSliceAlphaC0OffsetDiv2()
 	{
-		return slice_alpha_c0_offset_div2;
+		return 0;
 	}
 	int GetSliceBetaOffsetDiv2()
 	{
-		return slice_beta_offset_div2;
+		return 0;
 	}
 	bool GetConstrainedIntraPredFlag()
 	{
-		return constrained_intra_pred_flag;
+		return info.constrained_intra_pred_flag;
 	}
 	bool GetRedundantPicCntPresentFlag()
 	{
-		return redundant_pic_cnt_present_flag;
+		return info.redundant_pic_cnt_present_flag;
 	}
 
 private:
-	BitStream *bs = 0;
-	unsigned char *stream = 0;
-	int length = 0;
-
-	// PPS参数
-	int pic_parameter_set_id;                     // ue(v)
-	int seq_parameter_set_id;                     // ue(v)
-	bool entropy_coding_mode_flag;                // u(1)
-	bool bottom_field_pic_order_in_frame_present_flag; // u(1)
-	int num_slice_groups_minus1;                  // ue(v)
-	int slice_group_map_type;                     // ue(v)
-	std::vector<int> run_length_minus1;           // ue(v)
-	std::vector<int> top_left;                    // ue(v)
-	std::vector<int> bottom_right;                // ue(v)
-	int slice_group_change_direction_flag;        // u(1)
-	int slice_group_change_rate_minus1;           // ue(v)
-	int pic_size_in_map_units_minus1;             // ue(v)
-	std::vector<int> slice_group_id;              // u(v)
-	int num_ref_idx_l0_default_active_minus1;     // ue(v)
-	int num_ref_idx_l1_default_active_minus1;     // ue(v)
-	bool weighted_pred_flag;                      // u(1)
-	int weighted_bipred_idc;                      // u(2)
-	int pic_init_qp_minus26;                      // se(v)
-	int pic_init_qs_minus26;                      // se(v)
-	int chroma_qp_index_offset;                   // se(v)
-	bool deblocking_filter_control_present_flag;  // u(1)
-	int disable_deblocking_filter_idc;            // ue(v)
-	int slice_alpha_c0_offset_div2;               // se(v)
-	int slice_beta_offset_div2;                   // se(v)
-	bool constrained_intra_pred_flag;             // u(1)
-	bool redundant_pic_cnt_present_flag;          // u(1)
+	PpsInfo info;
+	bool valid;
+};
+
+// SPS/PPS缓存：按id保存，收到内容完全相同的参数集时跳过解析
+class ParamSetCache
+{
+public:
+	ParamSetCache()
+	{
+		generation = 0;
+		for (int i = 0; i < MAX_SPS_COUNT; i++)
+		{
+			spsPresent[i] = false;
+			spsGeneration[i] = 0;
+		}
+		for (int i = 0; i < MAX_PPS_COUNT; i++)
+		{
+			ppsPresent[i] = false;
+			ppsGeneration[i] = 0;
+		}
+	}
+	~ParamSetCache()
+	{}
+
+	ParamSetCache(const ParamSetCache &b) = delete;
+	ParamSetCache &operator=(const ParamSetCache &b) = delete;
+
+	/*
+	 * 输入SPS/PPS(其它类型忽略)，data可以包含起始码
+	 * 返回：0 与缓存内容相同，未重新解析；1 新的参数集或内容有变化，已解析；-1 解析失败或类型不符
+	 * SPS变化时，已缓存的引用该SPS的PPS会按新的SPS重新解析，其版本号同时加1；重新解析失败的PPS被删除
+	 */
+	int Update(Nalu &nalu);
+	int UpdateSps(const unsigned char *data, int len);
+	int UpdatePps(const unsigned char *data, int len);
+
+	/* 获取已缓存的参数集，不存在时返回NULL */
+	const SpsInfo *GetSps(int id);
+	const PpsInfo *GetPps(int id);
+
+	/* 根据slice中的pic_parameter_set_id获取PPS及其引用的SPS，任一不存在时返回false */
+	bool GetParamSets(int ppsId, const PpsInfo *&pps, const SpsInfo *&sps);
+
+	/* 任一参数集内容发生变化或被删除时加1，可用于判断图像格式(宽高等)是否需要重新获取 */
+	unsigned int GetGeneration()
+	{
+		return generation;
+	}
+
+	/*
+	 * 指定参数集的版本号，0表示不存在，内容每变化一次加1
+	 * 删除(Clear或重新解析失败)后不清零，同一id再次出现时继续递增，不会与删除前的版本号相同
+	 */
+	unsigned int GetSpsGeneration(int id)
+	{
+		return (id >= 0 && id < MAX_SPS_COUNT && spsPresent[id]) ? spsGeneration[id] : 0;
+	}
+	unsigned int GetPpsGeneration(int id)
+	{
+		return (id >= 0 && id < MAX_PPS_COUNT && ppsPresent[id]) ? ppsGeneration[id] : 0;
+	}
+
+	/* 清空所有参数集 */
+	void Clear();
+
+private:
+	unsigned int generation;
+	SpsInfo sps[MAX_SPS_COUNT];
+	PpsInfo pps[MAX_PPS_COUNT];
+	std::vector<unsigned char> spsData[MAX_SPS_COUNT]; // 原始数据(EBSP，不含起始码)，用于比较
+	std::vector<unsigned char> ppsData[MAX_PPS_COUNT];
+	bool spsPresent[MAX_SPS_COUNT]; // 是否已缓存
+	bool ppsPresent[MAX_PPS_COUNT];
+	unsigned int spsGeneration[MAX_SPS_COUNT]; // 只增不减，是否存在由spsPresent表示
+	unsigned int ppsGeneration[MAX_PPS_COUNT];
 };
 
 
@@ -0,0 +1,277 @@
+/*
+ * H264图像顺序号(POC)计算及显示顺序重排实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <utility>
+#include "easy_h264_poc.h"
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// POC计算
+void H264PocCalc::Reset()
+{
+	prevPicOrderCntMsb = 0;
+	prevPicOrderCntLsb = 0;
+	prevFrameNumOffset = 0;
+	prevFrameNum = 0;
+	prevMmco5 = false;
+}
+
+bool H264PocCalc::Compute(const SliceHeader &sh, const SpsInfo &sps, PocInfo &poc)
+{
+	poc.top_poc = 0;
+	poc.bottom_poc = 0;
+	poc.poc = 0;
+	poc.mmco5 = false;
+	if (sh.parse_level < SLICE_PARSE_POC)
+		return false;
+
+	bool idr = sh.IsIdr();
+	bool field = sh.field_pic_flag;
+	bool bottom = field && sh.bottom_field_flag;
+	bool ref = sh.nal_ref_idc != 0;
+	poc.mmco5 = sh.parse_level >= SLICE_PARSE_ALL && sh.memory_management_control_operation_5;
+
+	int frameNumOffset = 0;
+	if (sps.pic_order_cnt_type == 0) // 8.2.1.1
+	{
+		if (idr)
+		{
+			prevPicOrderCntMsb = 0;
+			prevPicOrderCntLsb = 0;
+		}
+		int maxLsb = 1 << (sps.log2_max_pic_order_cnt_lsb_minus4 + 4);
+		int lsb = sh.pic_order_cnt_lsb;
+		int msb = prevPicOrderCntMsb;
+		if (lsb < prevPicOrderCntLsb && prevPicOrderCntLsb - lsb >= maxLsb / 2)
+			msb += maxLsb;
+		else if (lsb > prevPicOrderCntLsb && lsb - prevPicOrderCntLsb > maxLsb / 2)
+			msb -= maxLsb;
+
+		poc.top_poc = msb + lsb;
+		poc.bottom_poc = field ? msb + lsb : poc.top_poc + sh.delta_pic_order_cnt_bottom;
+
+		/* 下一个图像使用上一个参考图像的值 */
+		if (ref)
+		{
+			prevPicOrderCntMsb = msb;
+			prevPicOrderCntLsb = lsb;
+		}
+	}
+	else
+	{
+		/* 8.2.1.2/8.2.1.3：FrameNumOffset */
+		int maxFrameNum = 1 << (sps.log2_max_frame_num_minus4 + 4);
+		int prevOffset = prevMmco5 ? 0 : prevFrameNumOffset;
+		if (idr)
+			frameNumOffset = 0;
+		else if (prevFrameNum > sh.frame_num)
+			frameNumOffset = prevOffset + maxFrameNum;
+		else
+			frameNumOffset = prevOffset;
+
+		if (sps.pic_order_cnt_type == 1)
+		{
+			int cycle = sps.num_ref_frames_in_pic_order_cnt_cycle;
+			int absFrameNum = cycle != 0 ? frameNumOffset + sh.frame_num : 0;
+			if (!ref && absFrameNum > 0)
+				absFrameNum--;
+
+			int expected = 0;
+			if (absFrameNum > 0)
+			{
+				int deltaPerCycle = 0;
+				for (int i = 0; i < cycle; i++)
+					deltaPerCycle += sps.offset_for_ref_frame[i];
+				int cycleCnt = (absFrameNum - 1) / cycle;
+				int inCycle = (absFrameNum - 1) % cycle;
+				expected = cycleCnt * deltaPerCycle;
+				for (int i = 0; i <= inCycle; i++)
+					expected += sps.offset_for_ref_frame[i];
+			}
+			if (!ref)
+				expected += sps.offset_for_non_ref_pic;
+
+			if (!field)
+			{
+				poc.top_poc = expected + sh.delta_pic_order_cnt[0];
+				poc.bottom_poc = poc.top_poc + sps.offset_for_top_to_bottom_field + sh.delta_pic_order_cnt[1];
+			}
+			else if (!bottom)
+			{
+				poc.top_poc = expected + sh.delta_pic_order_cnt[0];
+			}
+			else
+			{
+				poc.bottom_poc = expected + sps.offset_for_top_to_bottom_field + sh.delta_pic_order_cnt[0];
+			}
+		}
+		else
+		{
+			int temp = 0;
+			if (!idr)
+				temp = ref ? 2 * (frameNumOffset + sh.frame_num) : 2 * (frameNumOffset + sh.frame_num) - 1;
+			poc.top_poc = temp;
+			poc.bottom_poc = temp;
+		}
+	}
+
+	if (!field)
+		poc.poc = poc.top_poc < poc.bottom_poc ? poc.top_poc : poc.bottom_poc;
+	else
+		poc.poc = bottom ? poc.bottom_poc : poc.top_poc;
+
+	/* 8.2.1：mmco5图像解码后POC减去tempPicOrderCnt，frame_num视为0 */
+	if (poc.mmco5)
+	{
+		int temp = poc.poc;
+		poc.top_poc -= temp;
+		poc.bottom_poc -= temp;
+		poc.poc = 0;
+		if (sps.pic_order_cnt_type == 0)
+		{
+			prevPicOrderCntMsb = 0;
+			prevPicOrderCntLsb = bottom ? 0 : poc.top_poc;
+		}
+	}
+	prevFrameNumOffset = frameNumOffset;
+	prevFrameNum = poc.mmco5 ? 0 : sh.frame_num;
+	prevMmco5 = poc.mmco5;
+	return true;
+}
+
+bool H264PocCalc::Compute(const AccessUnit &au, ParamSetCache &cache, PocInfo &poc)
+{
+	const PpsInfo *pps = NULL;
+	const SpsInfo *sps = NULL;
+	if (au.slice.parse_level < SLICE_PARSE_POC || !cache.GetParamSets(au.slice.pic_parameter_set_id, pps, sps))
+	{
+		poc.top_poc = poc.bottom_poc = poc.poc = 0;
+		poc.mmco5 = false;
+		return false;
+	}
+
+	/* 组装访问单元时只解析到SLICE_PARSE_POC，mmco5只可能出现在非IDR的参考图像中 */
+	if (au.slice.IsIdr() || au.slice.nal_ref_idc == 0)
+		return Compute(au.slice, *sps, poc);
+
+	SliceHeader sh;
+	for (size_t i = 0; i < au.nalus.size(); i++)
+	{
+		const Nalu &nalu = au.nalus[i];
+		if (nalu.type == NALU_TYPE_SLICE || nalu.type == NALU_TYPE_DPA)
+		{
+			if (ParseSliceHeader(nalu.pdata, nalu.length, cache, sh, SLICE_PARSE_ALL))
+				return Compute(sh, *sps, poc);
+			break;
+		}
+	}
+	return Compute(au.slice, *sps, poc);
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 显示顺序重排
+H264ReorderBuffer::H264ReorderBuffer(int reorderDepth)
+{
+	fixedDepth = reorderDepth < H264_REORDER_MAX ? reorderDepth : H264_REORDER_MAX;
+	Reset();
+}
+
+void H264ReorderBuffer::Reset()
+{
+	calc.Reset();
+	depth = fixedDepth >= 0 ? fixedDepth : 0;
+	for (int i = 0; i < H264_REORDER_SLOTS; i++)
+	{
+		slots[i].au.Clear();
+		freeList[i] = H264_REORDER_SLOTS - 1 - i;
+	}
+	freeCount = H264_REORDER_SLOTS;
+	pendingCount = 0;
+	pendingFields = 0;
+	readyPos = 0;
+	readyCount = 0;
+	decodeIndex = 0;
+	displayIndex = 0;
+}
+
+/* 把pending中POC最小的一项移到输出队列 */
+void H264ReorderBuffer::Bump()
+{
+	int min = 0;
+	for (int i = 1; i < pendingCount; i++)
+	{
+		if (slots[pending[i]].poc.poc < slots[pending[min]].poc.poc)
+			min = i;
+	}
+	int index = pending[min];
+	pending[min] = pending[--pendingCount];
+	pendingFields -= slots[index].au.slice.field_pic_flag ? 1 : 2;
+
+	slots[index].display_index = displayIndex++;
+	ready[(readyPos + readyCount) % H264_REORDER_SLOTS] = index;
+	readyCount++;
+}
+
+bool H264ReorderBuffer::Push(AccessUnit &au, ParamSetCache &cache)
+{
+	PocInfo poc;
+	if (freeCount == 0 || !calc.Compute(au, cache, poc))
+		return false;
+
+	if (fixedDepth < 0)
+	{
+		const PpsInfo *pps = NULL;
+		const SpsInfo *sps = NULL;
+		if (cache.GetParamSets(au.slice.pic_parameter_set_id, pps, sps))
+		{
+			int n = sps->vui.max_num_reorder_frames;
+			depth = n < 0 ? H264_REORDER_MAX : (n < H264_REORDER_MAX ? n : H264_REORDER_MAX);
+		}
+	}
+
+	/* IDR/mmco5之后POC重新开始，之前的图像全部先输出 */
+	if (au.slice.IsIdr() || poc.mmco5)
+	{
+		while (pendingCount > 0)
+			Bump();
+	}
+
+	int index = freeList[--freeCount];
+	ReorderedUnit &unit = slots[index];
+	std::swap(unit.au, au);
+	unit.poc = poc;
+	unit.decode_index = decodeIndex++;
+	pending[pendingCount++] = index;
+	pendingFields += unit.au.slice.field_pic_flag ? 1 : 2;
+
+	while (pendingFields > 2 * depth)
+		Bump();
+	return true;
+}
+
+bool H264ReorderBuffer::Pop(ReorderedUnit &out)
+{
+	if (readyCount == 0)
+		return false;
+
+	int index = ready[readyPos];
+	readyPos = (readyPos + 1) % H264_REORDER_SLOTS;
+	readyCount--;
+
+	ReorderedUnit &unit = slots[index];
+	std::swap(out.au, unit.au);
+	out.poc = unit.poc;
+	out.decode_index = unit.decode_index;
+	out.display_index = unit.display_index;
+	freeList[freeCount++] = index;
+	return true;
+}
+
+void H264ReorderBuffer::Flush()
+{
+	while (pendingCount > 0)
+		Bump();
+}
+
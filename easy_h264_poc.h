@@ -0,0 +1,128 @@
+/*
+ * H264图像顺序号(POC)计算及显示顺序重排
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_POC_H__
+#define __FREE_EASY_H264_POC_H__
+#include "easy_h264_frame.h"
+
+// 一幅图像(帧或场)的POC
+typedef struct PocInfo
+{
+	int top_poc; // TopFieldOrderCnt，底场时无意义
+	int bottom_poc; // BottomFieldOrderCnt，顶场时无意义
+	int poc; // PicOrderCnt()：帧为两者的较小值，场为该场的值
+	bool mmco5; // 图像包含memory_management_control_operation 5，之后的POC重新开始
+}PocInfo;
+
+/*
+ * POC计算(8.2.1)，支持pic_order_cnt_type 0/1/2，按解码顺序对每个主图像调用一次
+ * 需要记录上一个(参考)图像的状态，跳转后应调用Reset并从IDR开始
+ * 不处理frame_num间隔(gaps_in_frame_num)推断出的"不存在"的帧
+ */
+class H264PocCalc
+{
+public:
+	H264PocCalc()
+	{
+		Reset();
+	}
+
+	/*
+	 * sh至少解析到SLICE_PARSE_POC，是否有mmco5只在解析到SLICE_PARSE_ALL时才能得到，否则视为没有
+	 * mmco5图像输出的是按8.2.1调整后的POC
+	 */
+	bool Compute(const SliceHeader &sh, const SpsInfo &sps, PocInfo &poc);
+
+	/* 根据au.slice从cache中查找SPS，非IDR的参考图像会重新完整解析第一个slice头以得到mmco5 */
+	bool Compute(const AccessUnit &au, ParamSetCache &cache, PocInfo &poc);
+
+	void Reset();
+
+private:
+	/* pic_order_cnt_type 0：上一个参考图像 */
+	int prevPicOrderCntMsb;
+	int prevPicOrderCntLsb;
+	/* pic_order_cnt_type 1/2：上一个图像 */
+	int prevFrameNumOffset;
+	int prevFrameNum;
+	bool prevMmco5;
+};
+
+#define H264_REORDER_MAX 16 // 重排深度上限(max_num_reorder_frames最大为MaxDpbFrames，即16)
+#define H264_REORDER_SLOTS (2 * H264_REORDER_MAX + 2) // 重排缓冲区项数：按场重排时最多2*16+1项等待，再加1项输出
+
+// 重排缓冲区输出的一项
+typedef struct ReorderedUnit
+{
+	AccessUnit au;
+	PocInfo poc;
+	unsigned long long decode_index; // 解码顺序序号，从0开始
+	unsigned long long display_index; // 显示顺序序号，从0开始
+}ReorderedUnit;
+
+/*
+ * 显示顺序重排：按解码顺序输入访问单元，按POC从小到大输出
+ * 缓冲区中的帧数超过重排深度时立即输出POC最小的一项(C.4.5.3的"bumping"，延迟最小)
+ * 重排深度取自SPS的VUI max_num_reorder_frames(没有时为ParseSps推断的值)，也可以在构造时指定
+ * 场按半帧计算，同一帧的两个场分别输出；IDR或mmco5图像之前的所有图像先全部输出
+ * 缓冲区为固定的H264_REORDER_SLOTS项，访问单元以交换方式进出，不拷贝NALU数据
+ * 每次Push之后应Pop直到返回false，否则缓冲区可能用完
+ *
+ * 转封装时可由序号得到时间戳(dur为帧时长)：DTS = decode_index * dur，PTS = (display_index + GetDelay()) * dur
+ */
+class H264ReorderBuffer
+{
+public:
+	/* reorderDepth小于0时使用SPS中的值 */
+	explicit H264ReorderBuffer(int reorderDepth = -1);
+	~H264ReorderBuffer()
+	{}
+
+	H264ReorderBuffer(const H264ReorderBuffer &b) = delete;
+	H264ReorderBuffer &operator=(const H264ReorderBuffer &b) = delete;
+
+	/*
+	 * 输入一个访问单元，成功时au与缓冲区中的空闲项交换，返回后au内容无意义
+	 * 缺少SPS/PPS无法计算POC，或缓冲区已满时返回false，au不变
+	 */
+	bool Push(AccessUnit &au, ParamSetCache &cache);
+
+	/* 取出下一个可以输出的访问单元，没有时返回false，out.au原有内容被交换到缓冲区中复用 */
+	bool Pop(ReorderedUnit &out);
+
+	/* 输入结束：之后Pop依次取出所有剩余的访问单元 */
+	void Flush();
+
+	/* 丢弃所有缓存的访问单元，POC计算从头开始，用于跳转 */
+	void Reset();
+
+	/* 当前的重排深度(帧) */
+	int GetDelay() const
+	{
+		return depth;
+	}
+
+private:
+	void Bump();
+
+	int fixedDepth;
+	int depth;
+	H264PocCalc calc;
+	ReorderedUnit slots[H264_REORDER_SLOTS];
+	int freeList[H264_REORDER_SLOTS]; // 空闲项的下标(栈)
+	int freeCount;
+	int pending[H264_REORDER_SLOTS]; // 等待重排的项，无序
+	int pendingCount;
+	int pendingFields; // pending中的场数，帧计为2
+	int ready[H264_REORDER_SLOTS]; // 已确定输出顺序的项(环形队列)
+	int readyPos;
+	int readyCount;
+	unsigned long long decodeIndex;
+	unsigned long long displayIndex;
+};
+
+#endif
+
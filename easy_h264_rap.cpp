@@ -0,0 +1,170 @@
+/*
+ * H264随机访问点(RAP)检测实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include "easy_h264_rap.h"
+#include "easy_h264_sei.h"
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 随机访问点检测
+H264RapDetector::H264RapDetector(const RapCallback &callback)
+	: parser(false)
+{
+	this->callback = callback;
+	started = false;
+	frameCount = 0;
+	BeginUnit(0);
+}
+
+void H264RapDetector::BeginUnit(unsigned long long offset)
+{
+	memset(&entry, 0, sizeof(entry));
+	entry.offset = offset;
+	entry.frame = frameCount;
+	entry.recovery_frame_cnt = -1;
+	allIntra = true;
+	hasSlice = false;
+	spsId = -1;
+	ppsId = -1;
+	spsMask = 0;
+	memset(ppsMask, 0, sizeof(ppsMask));
+}
+
+/* 访问单元结束：根据主图像的slice头及收集到的信息判断是否为随机访问点 */
+void H264RapDetector::EndUnit()
+{
+	frameCount++;
+	if (!hasSlice)
+		return;
+
+	const SliceHeader &sh = au.slice;
+	entry.slice_type = sh.GetSliceType();
+	if (sh.IsIdr())
+		entry.flags |= H264_RAP_IDR;
+	if (allIntra)
+		entry.flags |= H264_RAP_INTRA;
+
+	/* 主图像引用的SPS/PPS是否在本访问单元中 */
+	if (ppsId >= 0 && (ppsMask[ppsId / 64] >> (ppsId % 64) & 1))
+		entry.flags |= H264_RAP_PPS;
+	if (spsId >= 0 && (spsMask >> spsId & 1))
+		entry.flags |= H264_RAP_SPS;
+
+	if ((entry.flags & (H264_RAP_IDR | H264_RAP_RECOVERY_POINT | H264_RAP_INTRA)) && callback)
+		callback(entry);
+}
+
+/* 记录NALU中与随机访问有关的信息，数据只在本次调用中使用 */
+void H264RapDetector::Inspect(Nalu &nalu)
+{
+	int type = nalu.GetNaluType();
+	if (type == NALU_TYPE_SLICE || type == NALU_TYPE_DPA || type == NALU_TYPE_IDR)
+	{
+		/* 只需要slice_type；冗余slice(redundant_pic_cnt>0)不属于主图像 */
+		SliceHeader sh;
+		ParseSliceHeader(nalu.GetData(), nalu.GetLength(), parser.GetParamSetCache(), sh, SLICE_PARSE_POC);
+		if (sh.parse_level >= SLICE_PARSE_TYPE && sh.redundant_pic_cnt == 0)
+		{
+			/*
+			 * 在这里记录主图像使用的PPS及其SPS：EndUnit时parser已经缓存了下一个访问单元的SPS/PPS，
+			 * 同一id的PPS可能已指向别的SPS
+			 */
+			if (!hasSlice)
+			{
+				const PpsInfo *pps = parser.GetParamSetCache().GetPps(sh.pic_parameter_set_id);
+				if (pps)
+				{
+					ppsId = pps->pic_parameter_set_id;
+					spsId = pps->seq_parameter_set_id;
+				}
+			}
+			hasSlice = true;
+			if (!sh.IsIntra())
+				allIntra = false;
+		}
+	}
+	else if (type == NALU_TYPE_SEI)
+	{
+		SeiIterator it(nalu.GetData(), nalu.GetLength());
+		it.Accept(SEI_RECOVERY_POINT);
+		SeiMessage msg;
+		SeiRecoveryPoint rp;
+		if (it.Next(msg) && ParseSeiRecoveryPoint(msg, rp))
+		{
+			entry.flags |= H264_RAP_RECOVERY_POINT;
+			entry.recovery_frame_cnt = rp.recovery_frame_cnt;
+			entry.exact_match_flag = rp.exact_match_flag;
+			entry.broken_link_flag = rp.broken_link_flag;
+		}
+	}
+	else if (type == NALU_TYPE_SPS && nalu.GetLength() > 3)
+	{
+		BitStream bs(nalu.GetData() + 4, nalu.GetLength() - 4, true); // profile_idc、constraint_set_flag、level_idc之后
+		int id = bs.ReadUE();
+		if (!bs.IsError() && id >= 0 && id < MAX_SPS_COUNT)
+			spsMask |= 1u << id;
+	}
+	else if (type == NALU_TYPE_PPS && nalu.GetLength() > 1)
+	{
+		BitStream bs(nalu.GetData() + 1, nalu.GetLength() - 1, true);
+		int id = bs.ReadUE();
+		if (!bs.IsError() && id >= 0 && id < MAX_PPS_COUNT)
+			ppsMask[id / 64] |= 1ULL << (id % 64);
+	}
+}
+
+void H264RapDetector::Push(Nalu &nalu, unsigned long long offset)
+{
+	if (!nalu.GetData() || nalu.GetLength() <= 0)
+		return;
+
+	/* parser先更新SPS/PPS缓存并判断nalu是否开始了新的访问单元 */
+	if (parser.Push(nalu, au))
+	{
+		EndUnit();
+		BeginUnit(offset);
+	}
+	else if (!started)
+	{
+		entry.offset = offset;
+	}
+	started = true;
+	Inspect(nalu);
+}
+
+void H264RapDetector::Flush()
+{
+	if (parser.Flush(au))
+		EndUnit();
+	started = false;
+	BeginUnit(0);
+}
+
+void H264RapDetector::Reset()
+{
+	parser.Reset();
+	au.Clear();
+	started = false;
+	frameCount = 0;
+	BeginUnit(0);
+}
+
+bool ScanH264Raps(const std::string &filename, const RapCallback &callback, int readMode)
+{
+	H264FileParse file(filename, readMode);
+	H264RapDetector detector(callback);
+	Nalu nalu;
+	bool any = false;
+	while (file.GetNextNalu(nalu))
+	{
+		long long offset = file.GetNaluOffset(nalu);
+		detector.Push(nalu, offset >= 0 ? offset : 0);
+		any = true;
+	}
+	detector.Flush();
+	return any;
+}
+
@@ -0,0 +1,96 @@
+/*
+ * H264随机访问点(RAP)检测：IDR、带recovery_point SEI的访问单元、全I帧，以及访问单元中是否带有SPS/PPS
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_RAP_H__
+#define __FREE_EASY_H264_RAP_H__
+#include "easy_h264_frame.h"
+
+// RAP标志
+#define H264_RAP_IDR 0x01 // IDR访问单元
+#define H264_RAP_RECOVERY_POINT 0x02 // 访问单元带有recovery_point SEI
+#define H264_RAP_INTRA 0x04 // 主图像的所有slice都是I/SI slice(open GOP的I帧，显示顺序在其之前的B帧可能引用前一个GOP)
+#define H264_RAP_SPS 0x08 // 访问单元中带有该图像使用的SPS
+#define H264_RAP_PPS 0x10 // 访问单元中带有该图像使用的PPS
+
+// RAP表项
+typedef struct H264RapEntry
+{
+	/* 从该访问单元开始解码不需要之前的数据：带有SPS/PPS，并且是IDR或recovery_frame_cnt为0的恢复点 */
+	bool IsSelfContained() const
+	{
+		if ((flags & (H264_RAP_SPS | H264_RAP_PPS)) != (H264_RAP_SPS | H264_RAP_PPS))
+			return false;
+		return (flags & H264_RAP_IDR) || ((flags & H264_RAP_RECOVERY_POINT) && recovery_frame_cnt == 0);
+	}
+
+	unsigned long long offset; // 访问单元第一个NALU起始码在文件中的位置，可以直接传给Seek
+	unsigned long long frame; // 访问单元序号，从0开始
+	int flags; // H264_RAP_xxx
+	int slice_type; // 主图像第一个slice的类型SLICE_TYPE_xxx
+	int recovery_frame_cnt; // recovery_point中的值，没有recovery_point时为-1
+	bool exact_match_flag;
+	bool broken_link_flag;
+}H264RapEntry;
+
+// RAP回调：每检测到一个随机访问点调用一次
+typedef std::function<void(const H264RapEntry &rap)> RapCallback;
+
+/*
+ * 随机访问点检测(推模式)：按文件顺序输入NALU，单遍输出RAP，不保存RAP表，内存占用与码流长度无关
+ * 访问单元的划分与AccessUnitParse一致；SEI只查找recovery_point，其余负载按长度跳过
+ * 只输出带有H264_RAP_IDR、H264_RAP_RECOVERY_POINT或H264_RAP_INTRA之一的访问单元
+ */
+class H264RapDetector
+{
+public:
+	explicit H264RapDetector(const RapCallback &callback);
+	~H264RapDetector()
+	{}
+
+	H264RapDetector(const H264RapDetector &b) = delete;
+	H264RapDetector &operator=(const H264RapDetector &b) = delete;
+
+	/* 输入一个NALU及其起始码在文件中的位置(参见H264FileParse::GetNaluOffset)，nalu只在调用期间使用 */
+	void Push(Nalu &nalu, unsigned long long offset);
+
+	/* 输入结束，检测最后一个访问单元 */
+	void Flush();
+
+	/* 丢弃未完成的访问单元及缓存的SPS/PPS，访问单元序号从0开始，用于跳转 */
+	void Reset();
+
+	/* 已完成的访问单元个数 */
+	unsigned long long GetFrameCount()
+	{
+		return frameCount;
+	}
+
+private:
+	void BeginUnit(unsigned long long offset);
+	void EndUnit();
+	void Inspect(Nalu &nalu);
+
+	RapCallback callback;
+	AccessUnitParse parser; // 只用于划分访问单元，不拷贝数据
+	AccessUnit au; // 划分出的访问单元，只使用其中的slice头
+	bool started; // 是否已有未完成的访问单元
+	unsigned long long frameCount;
+
+	/* 当前访问单元 */
+	H264RapEntry entry;
+	bool allIntra; // 到目前为止主图像的slice都是I/SI slice
+	bool hasSlice;
+	int spsId; // 主图像第一个slice使用的SPS id，在解析slice时记录，-1表示未知
+	int ppsId; // 主图像第一个slice使用的PPS id
+	unsigned int spsMask; // 访问单元中出现的SPS id
+	unsigned long long ppsMask[MAX_PPS_COUNT / 64]; // 访问单元中出现的PPS id
+};
+
+/* 用H264FileParse扫描整个文件，readMode参见H264FileParse，文件打开失败或没有NALU时返回false */
+bool ScanH264Raps(const std::string &filename, const RapCallback &callback, int readMode = H264_FILE_READ_MMAP);
+
+#endif
+
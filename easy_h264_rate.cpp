@@ -0,0 +1,101 @@
+/*
+ * 码率/帧率统计实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include "easy_h264_rate.h"
+
+H264RateAnalyzer::H264RateAnalyzer(int window, double defaultFps)
+{
+	this->window = window > 0 ? window : 1;
+	this->defaultFps = defaultFps;
+	winBytes.resize(this->window);
+	winDuration.resize(this->window);
+	Reset();
+}
+
+void H264RateAnalyzer::Reset()
+{
+	winPos = 0;
+	winCount = 0;
+	winByteSum = 0;
+	winDurationSum = 0;
+	memset(&info, 0, sizeof(info));
+	if (defaultFps > 0)
+		info.nominal_fps = defaultFps;
+}
+
+void H264RateAnalyzer::Push(int bytes, double duration)
+{
+	if (bytes < 0)
+		bytes = 0;
+	if (duration < 0)
+		duration = 0;
+
+	info.frames++;
+	info.bytes += bytes;
+	info.duration += duration;
+	info.instant_bitrate = duration > 0 ? bytes * 8 / duration : 0;
+	info.instant_fps = duration > 0 ? 1 / duration : 0;
+	info.average_bitrate = info.duration > 0 ? info.bytes * 8 / info.duration : 0;
+
+	/* 窗口满时先移出最旧的一项 */
+	if (winCount == window)
+	{
+		winByteSum -= winBytes[winPos];
+		winDurationSum -= winDuration[winPos];
+	}
+	else
+	{
+		winCount++;
+	}
+	winBytes[winPos] = bytes;
+	winDuration[winPos] = duration;
+	winByteSum += bytes;
+	winDurationSum += duration;
+	winPos = (winPos + 1) % window;
+
+	/* 浮点累加误差：窗口中时长全为0时归零 */
+	if (winDurationSum < 1e-9)
+		winDurationSum = 0;
+	info.window_bitrate = winDurationSum > 0 ? winByteSum * 8 / winDurationSum : 0;
+	info.window_fps = winDurationSum > 0 ? winCount / winDurationSum : 0;
+	if (winCount == window && info.window_bitrate > info.max_window_bitrate)
+		info.max_window_bitrate = info.window_bitrate;
+}
+
+void H264RateAnalyzer::Push(int bytes, const SpsInfo *sps, bool field)
+{
+	double fps = 0;
+	if (sps)
+	{
+		const VuiInfo &vui = sps->vui;
+		const HrdInfo *hrd = vui.nal_hrd_parameters_present_flag ? &vui.nal_hrd
+			: (vui.vcl_hrd_parameters_present_flag ? &vui.vcl_hrd : NULL);
+		if (hrd)
+		{
+			info.hrd_bitrate = hrd->GetBitRate(hrd->cpb_cnt_minus1);
+			info.hrd_cpb_size = hrd->GetCpbSize(hrd->cpb_cnt_minus1);
+		}
+		if (sps->GetFrameRate(fps))
+			info.nominal_fps = fps;
+	}
+	if (fps <= 0)
+		fps = defaultFps;
+
+	double duration = fps > 0 ? 1 / fps : 0;
+	Push(bytes, field ? duration / 2 : duration);
+}
+
+void H264RateAnalyzer::Push(const AccessUnit &au, ParamSetCache &cache)
+{
+	const PpsInfo *pps = NULL;
+	const SpsInfo *sps = NULL;
+	if (!cache.GetParamSets(au.slice.pic_parameter_set_id, pps, sps))
+		sps = NULL;
+	bool field = au.slice.parse_level >= SLICE_PARSE_FRAME_NUM && au.slice.field_pic_flag;
+	Push(au.size, sps, field);
+}
+
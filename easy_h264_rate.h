@@ -0,0 +1,75 @@
+/*
+ * 码率/帧率统计：根据VUI中的timing_info及每个访问单元的字节数，单遍计算瞬时、滑动窗口及平均码率和帧率
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_RATE_H__
+#define __FREE_EASY_H264_RATE_H__
+#include "easy_h264_frame.h"
+
+#define H264_RATE_WINDOW 30 // 默认滑动窗口大小(访问单元个数)
+
+// 统计结果：码率单位为bit/s，时间单位为秒，无法计算时为0
+typedef struct H264RateInfo
+{
+	unsigned long long frames; // 访问单元个数
+	unsigned long long bytes; // 所有访问单元的字节数之和
+	double duration; // 所有访问单元的时长之和
+	double nominal_fps; // SPS中timing_info给出的帧率
+	unsigned long long hrd_bitrate; // NAL HRD(没有时为VCL HRD)最后一个CPB的码率
+	unsigned long long hrd_cpb_size; // 同上，CPB大小(bit)
+	double instant_bitrate; // 最后一个访问单元
+	double instant_fps;
+	double window_bitrate; // 最近window个访问单元
+	double window_fps;
+	double average_bitrate; // 全部访问单元
+	double max_window_bitrate; // 窗口码率的最大值，窗口未满之前不统计
+}H264RateInfo;
+
+/*
+ * 码率/帧率统计：每输入一个访问单元更新一次，窗口为构造时分配的固定大小环形缓冲区
+ * 访问单元时长取自SPS：帧为2个tick，场为1个tick(tick = num_units_in_tick / time_scale)
+ * SPS没有timing_info时使用构造时给出的defaultFps，都没有时只统计字节数和帧数
+ * 不解析pic_timing SEI，pic_struct指定的重复场/帧不计入时长
+ */
+class H264RateAnalyzer
+{
+public:
+	explicit H264RateAnalyzer(int window = H264_RATE_WINDOW, double defaultFps = 0);
+	~H264RateAnalyzer()
+	{}
+
+	H264RateAnalyzer(const H264RateAnalyzer &b) = delete;
+	H264RateAnalyzer &operator=(const H264RateAnalyzer &b) = delete;
+
+	/* 输入一个访问单元的字节数及时长(秒) */
+	void Push(int bytes, double duration);
+
+	/* 时长由sps计算，field为true表示访问单元只有一个场 */
+	void Push(int bytes, const SpsInfo *sps, bool field = false);
+
+	/* 根据au中slice头的pic_parameter_set_id从cache中查找SPS，找不到时按defaultFps计算 */
+	void Push(const AccessUnit &au, ParamSetCache &cache);
+
+	const H264RateInfo &GetInfo() const
+	{
+		return info;
+	}
+
+	void Reset();
+
+private:
+	int window;
+	double defaultFps;
+	std::vector<int> winBytes; // 环形缓冲区：最近window个访问单元的字节数及时长
+	std::vector<double> winDuration;
+	int winPos;
+	int winCount;
+	unsigned long long winByteSum;
+	double winDurationSum;
+	H264RateInfo info;
+};
+
+#endif
+
@@ -0,0 +1,262 @@
+/*
+ * H264起始码查找(SIMD加速)实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include "easy_h264_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EASY_H264_X86 1
+#endif
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 查找 00 00 xx 字节序列：xx为01时是起始码，为03时是防竞争字节
+typedef const unsigned char *(*FindPatternFunc)(const unsigned char *p, const unsigned char *end, unsigned char third);
+
+/* 逐字节查找，同时用于SIMD版本的尾部处理，返回第一个0的位置 */
+static inline const unsigned char *FindPatternTail(const unsigned char *q, const unsigned char *end, unsigned char third)
+{
+	for (; q + 3 <= end; q++)
+	{
+		if (q[2] != 0 && q[2] != third) // 第3个字节既不是0也不是xx，可以跳过3个字节
+		{
+			q += 2;
+			continue;
+		}
+		if (q[0] == 0 && q[1] == 0 && q[2] == third)
+			return q;
+	}
+	return NULL;
+}
+
+/* 标量实现 */
+static const unsigned char *FindPatternScalar(const unsigned char *p, const unsigned char *end, unsigned char third)
+{
+	return FindPatternTail(p, end, third);
+}
+
+#ifdef EASY_H264_X86
+/* SSE2实现：每次处理16字节，不含0x00时直接跳过 */
+__attribute__((target("sse2")))
+static const unsigned char *FindPatternSSE2(const unsigned char *p, const unsigned char *end, unsigned char third)
+{
+	const unsigned char *q = p;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i xx = _mm_set1_epi8((char)third);
+	while (end - q >= 18) // 需要读取q[0, 18)
+	{
+		__m128i za = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)q), zero);
+		if (_mm_movemask_epi8(za) == 0)
+		{
+			q += 16;
+			continue;
+		}
+		__m128i zb = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(q + 1)), zero);
+		__m128i xc = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(q + 2)), xx);
+		int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(za, zb), xc));
+		if (mask)
+			return q + __builtin_ctz(mask);
+		q += 16;
+	}
+	return FindPatternTail(q, end, third);
+}
+
+/* AVX2实现：每次处理32字节，不含0x00时直接跳过 */
+__attribute__((target("avx2")))
+static const unsigned char *FindPatternAVX2(const unsigned char *p, const unsigned char *end, unsigned char third)
+{
+	const unsigned char *q = p;
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i xx = _mm256_set1_epi8((char)third);
+	while (end - q >= 34) // 需要读取q[0, 34)
+	{
+		__m256i za = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)q), zero);
+		if (_mm256_movemask_epi8(za) == 0)
+		{
+			q += 32;
+			continue;
+		}
+		__m256i zb = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(q + 1)), zero);
+		__m256i xc = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(q + 2)), xx);
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(za, zb), xc));
+		if (mask)
+			return q + __builtin_ctz(mask);
+		q += 32;
+	}
+	return FindPatternTail(q, end, third);
+}
+#endif
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 起始码查找
+/* 已找到 00 00 01 的位置q，检查前一个字节确定是3字节还是4字节起始码 */
+static inline const unsigned char *StartCodeAt(const unsigned char *q, const unsigned char *p, int *startCodeLen)
+{
+	if (!q)
+		return NULL;
+	if (q > p && q[-1] == 0)
+	{
+		if (startCodeLen) *startCodeLen = 4;
+		return q - 1;
+	}
+	if (startCodeLen) *startCodeLen = 3;
+	return q;
+}
+
+/* 标量实现 */
+static const unsigned char *FindStartCodeScalar(const unsigned char *p, const unsigned char *end, int *startCodeLen)
+{
+	if (!p || !end || end - p < 3)
+		return NULL;
+	return StartCodeAt(FindPatternScalar(p, end, 1), p, startCodeLen);
+}
+
+#ifdef EASY_H264_X86
+static const unsigned char *FindStartCodeSSE2(const unsigned char *p, const unsigned char *end, int *startCodeLen)
+{
+	if (!p || !end || end - p < 3)
+		return NULL;
+	return StartCodeAt(FindPatternSSE2(p, end, 1), p, startCodeLen);
+}
+
+static const unsigned char *FindStartCodeAVX2(const unsigned char *p, const unsigned char *end, int *startCodeLen)
+{
+	if (!p || !end || end - p < 3)
+		return NULL;
+	return StartCodeAt(FindPatternAVX2(p, end, 1), p, startCodeLen);
+}
+#endif
+
+/* 根据CPU特性选择实现 */
+static FindStartCodeFunc SelectFindStartCodeFunc()
+{
+	FindStartCodeFunc func = GetFindStartCodeFunc("avx2");
+	if (!func)
+		func = GetFindStartCodeFunc("sse2");
+	if (!func)
+		func = FindStartCodeScalar;
+	return func;
+}
+
+static FindStartCodeFunc GetDefaultFindStartCodeFunc()
+{
+	static FindStartCodeFunc func = SelectFindStartCodeFunc();
+	return func;
+}
+
+/* 与起始码查找使用相同的指令集 */
+static FindPatternFunc SelectFindPatternFunc()
+{
+#ifdef EASY_H264_X86
+	FindStartCodeFunc func = GetDefaultFindStartCodeFunc();
+	if (func == FindStartCodeAVX2)
+		return FindPatternAVX2;
+	if (func == FindStartCodeSSE2)
+		return FindPatternSSE2;
+#endif
+	return FindPatternScalar;
+}
+
+static FindPatternFunc GetDefaultFindPatternFunc()
+{
+	static FindPatternFunc func = SelectFindPatternFunc();
+	return func;
+}
+
+const unsigned char *FindStartCode(const unsigned char *p, const unsigned char *end, int *startCodeLen)
+{
+	return GetDefaultFindStartCodeFunc()(p, end, startCodeLen);
+}
+
+FindStartCodeFunc GetFindStartCodeFunc(const char *impl)
+{
+	if (!impl)
+		return NULL;
+	if (strcmp(impl, "scalar") == 0)
+		return FindStartCodeScalar;
+#ifdef EASY_H264_X86
+	__builtin_cpu_init();
+	if (strcmp(impl, "sse2") == 0 && __builtin_cpu_supports("sse2"))
+		return FindStartCodeSSE2;
+	if (strcmp(impl, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+		return FindStartCodeAVX2;
+#endif
+	return NULL;
+}
+
+const char *GetStartCodeScanImpl()
+{
+	FindStartCodeFunc func = GetDefaultFindStartCodeFunc();
+#ifdef EASY_H264_X86
+	if (func == FindStartCodeAVX2)
+		return "avx2";
+	if (func == FindStartCodeSSE2)
+		return "sse2";
+#endif
+	return "scalar";
+}
+
+int SkipStartCode(const unsigned char *data, int len)
+{
+	if (len > 3 && data[0] == 0 && data[1] == 0 && data[2] == 1)
+		return 3;
+	if (len > 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1)
+		return 4;
+	return 0;
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// EBSP转RBSP
+int EbspToRbsp(const unsigned char *src, int len, unsigned char *dst, int *epbPos, int epbMax)
+{
+	if (!src || !dst || len <= 0)
+		return 0;
+
+	FindPatternFunc find = GetDefaultFindPatternFunc();
+	const unsigned char *end = src + len;
+	const unsigned char *from = src; // 下一段待拷贝数据的起始位置
+	const unsigned char *q = src;
+	unsigned char *out = dst;
+	int count = 0;
+
+	while ((q = find(q, end, 3)) != NULL)
+	{
+		const unsigned char *epb = q + 2;
+		/* 03后面必须是00~03或者已经是最后一个字节，否则不是防竞争字节 */
+		if (epb + 1 < end && epb[1] > 3)
+		{
+			q = epb + 1;
+			continue;
+		}
+
+		/* 两个防竞争字节之间的数据整块拷贝，原地转换时用memmove */
+		int n = epb - from;
+		if (out != from)
+			memmove(out, from, n);
+		out += n;
+		from = epb + 1;
+
+		if (epbPos && count < epbMax)
+			epbPos[count] = epb - src;
+		count++;
+
+		q = epb + 1; // 防竞争字节之后重新计算连续的0
+	}
+
+	int n = end - from;
+	if (out != from && n > 0)
+		memmove(out, from, n);
+	out += n;
+	return out - dst;
+}
+
+int RbspToEbspOffset(int rbspOffset, const int *epbPos, int epbCount)
+{
+	int offset = rbspOffset;
+	for (int i = 0; i < epbCount && epbPos && epbPos[i] <= offset; i++)
+		offset++; // 每个在该位置之前(含)的防竞争字节使EBSP偏移加1
+	return offset;
+}
@@ -0,0 +1,41 @@
+/*
+ * H264起始码查找(SIMD加速)
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_SCAN_H__
+#define __FREE_EASY_H264_SCAN_H__
+
+// 起始码查找函数原型
+typedef const unsigned char *(*FindStartCodeFunc)(const unsigned char *p, const unsigned char *end, int *startCodeLen);
+
+/*
+ * 在[p, end)中查找第一个完整的起始码(00 00 01 或 00 00 00 01)
+ * 返回起始码首字节位置，startCodeLen返回起始码长度(3或4)；未找到返回NULL
+ * 运行时根据CPU特性自动选择AVX2/SSE2/标量实现
+ */
+const unsigned char *FindStartCode(const unsigned char *p, const unsigned char *end, int *startCodeLen);
+
+/* 按名称获取实现："avx2"、"sse2"或"scalar"，CPU不支持时返回NULL，供性能对比使用 */
+FindStartCodeFunc GetFindStartCodeFunc(const char *impl);
+
+/* 当前使用的实现名称："avx2"、"sse2"或"scalar" */
+const char *GetStartCodeScanImpl();
+
+/* data以起始码开头时返回起始码长度(3或4)，否则返回0；起始码之后至少还要有1个字节 */
+int SkipStartCode(const unsigned char *data, int len);
+
+/*
+ * EBSP转RBSP：去掉防竞争字节(00 00 03 xx中的03，xx为00~03或03是最后一个字节)
+ * 两个防竞争字节之间的数据整块拷贝，查找使用与FindStartCode相同的SIMD实现
+ * dst至少需要len字节，可以等于src(原地转换)
+ * epbPos不为NULL时按顺序保存被去掉的字节在src中的下标，最多保存epbMax个
+ * 返回RBSP长度，len减去返回值即为去掉的字节数
+ */
+int EbspToRbsp(const unsigned char *src, int len, unsigned char *dst, int *epbPos = 0, int epbMax = 0);
+
+/* 根据EbspToRbsp记录的防竞争字节位置，将RBSP中的字节偏移映射回EBSP中的偏移 */
+int RbspToEbspOffset(int rbspOffset, const int *epbPos, int epbCount);
+
+#endif
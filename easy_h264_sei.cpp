@@ -0,0 +1,357 @@
+/*
+ * H264 SEI解析实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include "easy_h264_sei.h"
+
+#define SEI_PARSE_BUFFER_SIZE 1024 // 有防竞争字节时解析用的临时缓冲区，足够容纳buffering_period等消息
+
+int SeiMessage::CopyPayload(unsigned char *out, int size) const
+{
+	if (IsContiguous())
+	{
+		int n = payload_size < size ? payload_size : size;
+		memcpy(out, data, n);
+		return n;
+	}
+
+	int n = 0;
+	int z = lead_zeros;
+	for (int i = 0; i < data_len && n < size; i++)
+	{
+		if (z >= 2 && data[i] == 0x03) // 防竞争字节
+		{
+			z = 0;
+			continue;
+		}
+		z = data[i] == 0 ? z + 1 : 0;
+		out[n++] = data[i];
+	}
+	return n;
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// SEI消息遍历
+SeiIterator::SeiIterator(const unsigned char *data, int len)
+{
+	if (!data || len < 0)
+		len = 0;
+	int startCodeLen = SkipStartCode(data, len);
+	end = data + len;
+	p = startCodeLen < len ? data + startCodeLen + 1 : end; // 跳过NALU头
+	zeros = 0;
+	filter = ~0ULL;
+	error = false;
+}
+
+void SeiIterator::Accept(int payloadType)
+{
+	if (payloadType < 0)
+		return;
+	if (filter == ~0ULL)
+		filter = 0;
+	filter |= 1ULL << (payloadType < 63 ? payloadType : 63);
+}
+
+void SeiIterator::AcceptAll()
+{
+	filter = ~0ULL;
+}
+
+/* 读取一个RBSP字节，数据不足时返回-1 */
+int SeiIterator::ReadByte()
+{
+	if (p < end && zeros >= 2 && *p == 0x03)
+	{
+		p++;
+		zeros = 0;
+	}
+	if (p >= end)
+		return -1;
+	int b = *p++;
+	zeros = b == 0 ? (zeros < 2 ? zeros + 1 : 2) : 0;
+	return b;
+}
+
+/* 跳过n个RBSP字节：只在0x03处检查是否为防竞争字节 */
+bool SeiIterator::Skip(int n)
+{
+	if (n <= 0)
+		return true;
+	if (p < end && zeros >= 2 && *p == 0x03)
+	{
+		p++;
+		zeros = 0;
+	}
+
+	const unsigned char *target = p + n;
+	const unsigned char *q = p;
+	while (q < target && target <= end)
+	{
+		q = (const unsigned char *)memchr(q, 0x03, target - q);
+		if (!q)
+			break;
+		/* q之前的两个字节都在p之前时使用zeros */
+		int before = q - p;
+		bool epb = before >= 2 ? (q[-1] == 0 && q[-2] == 0)
+			: (before == 1 ? (q[-1] == 0 && zeros >= 1) : zeros >= 2);
+		if (epb)
+			target++;
+		q++;
+	}
+	if (target > end)
+	{
+		p = end;
+		error = true;
+		return false;
+	}
+
+	/* 更新zeros：target前面的字节不会是防竞争字节以外的0x03，直接按原始字节计算 */
+	int count = target - p;
+	if (target[-1] != 0)
+		zeros = 0;
+	else if (count >= 2)
+		zeros = target[-2] == 0 ? 2 : 1;
+	else
+		zeros = zeros >= 1 ? 2 : 1;
+	p = target;
+	return true;
+}
+
+/* more_rbsp_data()：剩下的只有rbsp_trailing_bits(0x80)及尾部的0时结束 */
+bool SeiIterator::MoreMessages()
+{
+	if (p >= end)
+		return false;
+	if (*p != 0x80)
+		return true;
+	for (const unsigned char *q = p + 1; q < end; q++)
+	{
+		if (*q != 0)
+			return true;
+	}
+	return false;
+}
+
+bool SeiIterator::Next(SeiMessage &msg)
+{
+	while (!error && MoreMessages())
+	{
+		/* payloadType、payloadSize：0xFF表示再加255 */
+		int type = 0, size = 0, b;
+		while ((b = ReadByte()) == 0xFF)
+			type += 255;
+		if (b >= 0)
+		{
+			type += b;
+			while ((b = ReadByte()) == 0xFF)
+				size += 255;
+		}
+		if (b < 0)
+		{
+			error = true;
+			return false;
+		}
+		size += b;
+
+		/* 负载开头的防竞争字节不属于负载 */
+		if (p < end && zeros >= 2 && *p == 0x03)
+		{
+			p++;
+			zeros = 0;
+		}
+
+		const unsigned char *start = p;
+		int startZeros = zeros;
+		if (!Skip(size))
+			return false;
+		if (!IsAccepted(type))
+			continue;
+
+		msg.payload_type = type;
+		msg.payload_size = size;
+		msg.data = start;
+		msg.data_len = p - start;
+		msg.lead_zeros = startZeros;
+		return true;
+	}
+	return false;
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 常用SEI消息的解析
+/* 负载没有防竞争字节时直接使用，否则去掉防竞争字节后拷贝到buf */
+static BitStream LoadPayload(const SeiMessage &msg, unsigned char *buf, int size)
+{
+	if (msg.IsContiguous())
+		return BitStream(msg.data, msg.payload_size);
+	return BitStream(buf, msg.CopyPayload(buf, size));
+}
+
+bool ParseSeiBufferingPeriod(const SeiMessage &msg, ParamSetCache &cache, SeiBufferingPeriod &bp)
+{
+	memset(&bp, 0, sizeof(bp));
+	if (msg.payload_type != SEI_BUFFERING_PERIOD)
+		return false;
+
+	unsigned char buf[SEI_PARSE_BUFFER_SIZE];
+	BitStream bs = LoadPayload(msg, buf, sizeof(buf));
+	bp.seq_parameter_set_id = bs.ReadUE();
+	const SpsInfo *sps = cache.GetSps(bp.seq_parameter_set_id);
+	if (!sps)
+		return false;
+
+	const VuiInfo &vui = sps->vui;
+	if (vui.nal_hrd_parameters_present_flag)
+	{
+		int bits = vui.nal_hrd.initial_cpb_removal_delay_length_minus1 + 1;
+		bp.nal_cpb_count = vui.nal_hrd.cpb_cnt_minus1 + 1;
+		for (int i = 0; i < bp.nal_cpb_count; i++)
+		{
+			bp.nal_initial_cpb_removal_delay[i] = (unsigned int)bs.ReadU(bits);
+			bp.nal_initial_cpb_removal_delay_offset[i] = (unsigned int)bs.ReadU(bits);
+		}
+	}
+	if (vui.vcl_hrd_parameters_present_flag)
+	{
+		int bits = vui.vcl_hrd.initial_cpb_removal_delay_length_minus1 + 1;
+		bp.vcl_cpb_count = vui.vcl_hrd.cpb_cnt_minus1 + 1;
+		for (int i = 0; i < bp.vcl_cpb_count; i++)
+		{
+			bp.vcl_initial_cpb_removal_delay[i] = (unsigned int)bs.ReadU(bits);
+			bp.vcl_initial_cpb_removal_delay_offset[i] = (unsigned int)bs.ReadU(bits);
+		}
+	}
+	return !bs.IsError();
+}
+
+/* 表D-1：pic_struct对应的NumClockTS，非法值返回0 */
+static int GetNumClockTs(int picStruct)
+{
+	static const int numClockTs[9] = { 1, 1, 1, 2, 2, 3, 3, 2, 3 };
+	return (picStruct >= 0 && picStruct < 9) ? numClockTs[picStruct] : 0;
+}
+
+static void ParseClockTimestamp(BitStream &bs, int timeOffsetLength, SeiClockTimestamp &ts)
+{
+	ts.seconds_value = ts.minutes_value = ts.hours_value = -1;
+	ts.clock_timestamp_flag = bs.ReadU1();
+	if (!ts.clock_timestamp_flag)
+		return;
+
+	ts.ct_type = bs.ReadU(2);
+	ts.nuit_field_based_flag = bs.ReadU1();
+	ts.counting_type = bs.ReadU(5);
+	ts.full_timestamp_flag = bs.ReadU1();
+	ts.discontinuity_flag = bs.ReadU1();
+	ts.cnt_dropped_flag = bs.ReadU1();
+	ts.n_frames = bs.ReadU(8);
+	if (ts.full_timestamp_flag)
+	{
+		ts.seconds_value = bs.ReadU(6);
+		ts.minutes_value = bs.ReadU(6);
+		ts.hours_value = bs.ReadU(5);
+	}
+	else if (bs.ReadU1()) // seconds_flag
+	{
+		ts.seconds_value = bs.ReadU(6);
+		if (bs.ReadU1()) // minutes_flag
+		{
+			ts.minutes_value = bs.ReadU(6);
+			if (bs.ReadU1()) // hours_flag
+				ts.hours_value = bs.ReadU(5);
+		}
+	}
+	if (timeOffsetLength > 0)
+	{
+		/* i(v)：补码 */
+		unsigned int v = (unsigned int)bs.ReadU(timeOffsetLength);
+		if (timeOffsetLength < 32 && (v >> (timeOffsetLength - 1)))
+			v |= ~0u << timeOffsetLength;
+		ts.time_offset = (int)v;
+	}
+}
+
+bool ParseSeiPicTiming(const SeiMessage &msg, const SpsInfo &sps, SeiPicTiming &pt)
+{
+	memset(&pt, 0, sizeof(pt));
+	if (msg.payload_type != SEI_PIC_TIMING)
+		return false;
+
+	unsigned char buf[SEI_PARSE_BUFFER_SIZE];
+	BitStream bs = LoadPayload(msg, buf, sizeof(buf));
+	const VuiInfo &vui = sps.vui;
+	const HrdInfo *hrd = vui.nal_hrd_parameters_present_flag ? &vui.nal_hrd
+		: (vui.vcl_hrd_parameters_present_flag ? &vui.vcl_hrd : NULL);
+	if (hrd)
+	{
+		pt.cpb_dpb_delays_present = true;
+		pt.cpb_removal_delay = (unsigned int)bs.ReadU(hrd->cpb_removal_delay_length_minus1 + 1);
+		pt.dpb_output_delay = (unsigned int)bs.ReadU(hrd->dpb_output_delay_length_minus1 + 1);
+	}
+	if (vui.pic_struct_present_flag)
+	{
+		pt.pic_struct_present = true;
+		pt.pic_struct = bs.ReadU(4);
+		pt.num_clock_ts = GetNumClockTs(pt.pic_struct);
+		if (pt.num_clock_ts == 0)
+			return false;
+		int timeOffsetLength = hrd ? hrd->time_offset_length : 24; // 没有HRD时time_offset_length推断为24
+		for (int i = 0; i < pt.num_clock_ts; i++)
+			ParseClockTimestamp(bs, timeOffsetLength, pt.clock[i]);
+	}
+	return !bs.IsError();
+}
+
+bool ParseSeiRecoveryPoint(const SeiMessage &msg, SeiRecoveryPoint &rp)
+{
+	memset(&rp, 0, sizeof(rp));
+	if (msg.payload_type != SEI_RECOVERY_POINT)
+		return false;
+
+	unsigned char buf[SEI_PARSE_BUFFER_SIZE];
+	BitStream bs = LoadPayload(msg, buf, sizeof(buf));
+	rp.recovery_frame_cnt = bs.ReadUE();
+	rp.exact_match_flag = bs.ReadU1();
+	rp.broken_link_flag = bs.ReadU1();
+	rp.changing_slice_group_idc = bs.ReadU(2);
+	return !bs.IsError();
+}
+
+bool ParseSeiUserDataUnregistered(const SeiMessage &msg, SeiUserDataUnregistered &ud)
+{
+	memset(&ud, 0, sizeof(ud));
+	if (msg.payload_type != SEI_USER_DATA_UNREGISTERED || msg.payload_size < SEI_UUID_SIZE)
+		return false;
+
+	if (msg.IsContiguous())
+	{
+		memcpy(ud.uuid, msg.data, SEI_UUID_SIZE);
+		ud.user_data = msg.data + SEI_UUID_SIZE;
+		ud.user_data_len = msg.payload_size - SEI_UUID_SIZE;
+		return true;
+	}
+
+	/* 有防竞争字节：逐字节取出uuid，user_data指向其后的第一个字节 */
+	int z = msg.lead_zeros, n = 0, i = 0;
+	for (; i < msg.data_len && n < SEI_UUID_SIZE; i++)
+	{
+		if (z >= 2 && msg.data[i] == 0x03)
+		{
+			z = 0;
+			continue;
+		}
+		z = msg.data[i] == 0 ? z + 1 : 0;
+		ud.uuid[n++] = msg.data[i];
+	}
+	if (i < msg.data_len && z >= 2 && msg.data[i] == 0x03)
+		i++;
+	ud.user_data = msg.data + i;
+	ud.user_data_len = msg.payload_size - SEI_UUID_SIZE;
+	ud.escaped = msg.data_len - i != ud.user_data_len;
+	return true;
+}
+
@@ -0,0 +1,157 @@
+/*
+ * H264 SEI解析：零拷贝遍历SEI消息，不关心的类型只按payloadSize跳过
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_SEI_H__
+#define __FREE_EASY_H264_SEI_H__
+#include "easy_h264_parser.h"
+
+// payloadType(D.1)
+#define SEI_BUFFERING_PERIOD 0
+#define SEI_PIC_TIMING 1
+#define SEI_PAN_SCAN_RECT 2
+#define SEI_FILLER_PAYLOAD 3
+#define SEI_USER_DATA_REGISTERED 4
+#define SEI_USER_DATA_UNREGISTERED 5
+#define SEI_RECOVERY_POINT 6
+
+#define SEI_UUID_SIZE 16
+#define SEI_MAX_CLOCK_TS 3 // NumClockTS最大为3
+
+// 一条SEI消息：负载为NALU中的视图，可能包含防竞争字节
+typedef struct SeiMessage
+{
+	/* 负载中没有防竞争字节，data开始的payload_size字节就是负载本身 */
+	bool IsContiguous() const
+	{
+		return data_len == payload_size;
+	}
+
+	/* 去掉防竞争字节后拷贝到out，最多size字节，返回拷贝的字节数 */
+	int CopyPayload(unsigned char *out, int size) const;
+
+	int payload_type;
+	int payload_size; // 负载字节数(RBSP)
+	const unsigned char *data; // 负载在NALU中的起始位置
+	int data_len; // 负载在NALU中占的字节数(EBSP)，包括其中的防竞争字节
+	int lead_zeros; // data之前连续的0字节数(最多2)，用于识别负载开头的防竞争字节
+}SeiMessage;
+
+/*
+ * SEI消息遍历：data为NALU_TYPE_SEI(可以包含起始码)，消息中的指针指向data，不拷贝
+ * 默认返回所有类型；调用Accept后只返回登记的类型，其余消息只读取payloadType/payloadSize后按长度跳过
+ * 跳过时用memchr查找防竞争字节，不逐字节处理负载
+ */
+class SeiIterator
+{
+public:
+	SeiIterator(const unsigned char *data, int len);
+
+	/* 登记需要的payloadType，可多次调用 */
+	void Accept(int payloadType);
+
+	/* 恢复为返回所有类型 */
+	void AcceptAll();
+
+	/* 取出下一条需要的消息，没有更多消息或数据错误时返回false */
+	bool Next(SeiMessage &msg);
+
+	/* payloadType/payloadSize超出数据范围等格式错误 */
+	bool IsError()
+	{
+		return error;
+	}
+
+private:
+	bool IsAccepted(int type)
+	{
+		return filter & (1ULL << (type < 63 ? type : 63));
+	}
+	bool MoreMessages();
+	int ReadByte();
+	bool Skip(int n);
+
+	const unsigned char *p;
+	const unsigned char *end;
+	int zeros; // p之前连续的0字节数(最多2)
+	unsigned long long filter; // 第i位表示payloadType为i，63表示63及以上
+	bool error;
+};
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 常用SEI消息的解析
+
+// buffering_period(D.1.2)
+typedef struct SeiBufferingPeriod
+{
+	int seq_parameter_set_id;                     // ue(v)
+	int nal_cpb_count;                            // NAL HRD不存在时为0
+	unsigned int nal_initial_cpb_removal_delay[MAX_CPB_COUNT];
+	unsigned int nal_initial_cpb_removal_delay_offset[MAX_CPB_COUNT];
+	int vcl_cpb_count;                            // VCL HRD不存在时为0
+	unsigned int vcl_initial_cpb_removal_delay[MAX_CPB_COUNT];
+	unsigned int vcl_initial_cpb_removal_delay_offset[MAX_CPB_COUNT];
+}SeiBufferingPeriod;
+
+// clock_timestamp
+typedef struct SeiClockTimestamp
+{
+	bool clock_timestamp_flag;                    // u(1)，为false时其余字段无意义
+	int ct_type;                                  // u(2)
+	bool nuit_field_based_flag;                   // u(1)
+	int counting_type;                            // u(5)
+	bool full_timestamp_flag;                     // u(1)
+	bool discontinuity_flag;                      // u(1)
+	bool cnt_dropped_flag;                        // u(1)
+	int n_frames;                                 // u(8)
+	int seconds_value;                            // u(6)，不存在时为-1
+	int minutes_value;                            // u(6)，不存在时为-1
+	int hours_value;                              // u(5)，不存在时为-1
+	int time_offset;                              // i(v)
+}SeiClockTimestamp;
+
+// pic_timing(D.1.3)
+typedef struct SeiPicTiming
+{
+	bool cpb_dpb_delays_present;                  // SPS中有NAL或VCL HRD
+	unsigned int cpb_removal_delay;               // u(v)
+	unsigned int dpb_output_delay;                // u(v)
+	bool pic_struct_present;                      // SPS中pic_struct_present_flag
+	int pic_struct;                               // u(4)，表D-1
+	int num_clock_ts;                             // NumClockTS
+	SeiClockTimestamp clock[SEI_MAX_CLOCK_TS];
+}SeiPicTiming;
+
+// recovery_point(D.1.8)
+typedef struct SeiRecoveryPoint
+{
+	int recovery_frame_cnt;                       // ue(v)
+	bool exact_match_flag;                        // u(1)
+	bool broken_link_flag;                        // u(1)
+	int changing_slice_group_idc;                 // u(2)
+}SeiRecoveryPoint;
+
+// user_data_unregistered(D.1.7)：user_data指向NALU中uuid之后的数据，不拷贝
+// escaped为true时其中包含防竞争字节，应使用SeiMessage::CopyPayload取出整个负载后跳过uuid
+typedef struct SeiUserDataUnregistered
+{
+	unsigned char uuid[SEI_UUID_SIZE];            // uuid_iso_iec_11578
+	const unsigned char *user_data;
+	int user_data_len;                            // RBSP字节数
+	bool escaped;
+}SeiUserDataUnregistered;
+
+/* buffering_period需要其中seq_parameter_set_id指定的SPS(HRD参数)，从cache中查找 */
+bool ParseSeiBufferingPeriod(const SeiMessage &msg, ParamSetCache &cache, SeiBufferingPeriod &bp);
+
+/* pic_timing需要当前激活的SPS */
+bool ParseSeiPicTiming(const SeiMessage &msg, const SpsInfo &sps, SeiPicTiming &pt);
+
+bool ParseSeiRecoveryPoint(const SeiMessage &msg, SeiRecoveryPoint &rp);
+
+bool ParseSeiUserDataUnregistered(const SeiMessage &msg, SeiUserDataUnregistered &ud);
+
+#endif
+
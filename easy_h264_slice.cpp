@@ -0,0 +1,274 @@
+/*
+ * H264 slice头解析实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include "easy_h264_slice.h"
+
+#define MAX_NUM_REF_IDX 32 // num_ref_idx_lx_active_minus1最大为31(场编码)
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// slice头解析
+void SliceHeader::Reset()
+{
+	memset(this, 0, sizeof(*this));
+	parse_level = -1;
+}
+
+/* NALU头以及first_mb_in_slice、slice_type、pic_parameter_set_id，不依赖SPS/PPS */
+static bool ParseSliceType(BitStream &bs, SliceHeader &sh)
+{
+	int header = bs.ReadU(8);
+	sh.nal_ref_idc = (header >> 5) & 0x03;
+	sh.nal_unit_type = header & 0x1f;
+	if ((header & 0x80) || (sh.nal_unit_type != NALU_TYPE_SLICE
+		&& sh.nal_unit_type != NALU_TYPE_DPA && sh.nal_unit_type != NALU_TYPE_IDR))
+		return false;
+
+	sh.first_mb_in_slice = bs.ReadUE();
+	sh.slice_type = bs.ReadUE();
+	sh.pic_parameter_set_id = bs.ReadUE();
+	if (bs.IsError() || sh.first_mb_in_slice < 0
+		|| sh.slice_type < 0 || sh.slice_type > 9
+		|| sh.pic_parameter_set_id < 0 || sh.pic_parameter_set_id >= MAX_PPS_COUNT)
+		return false;
+	sh.parse_level = SLICE_PARSE_TYPE;
+	return true;
+}
+
+/* ref_pic_list_modification()中的一个列表，只需要定位后面的字段 */
+static void SkipRefPicListModification(BitStream &bs)
+{
+	if (!bs.ReadU1()) // ref_pic_list_modification_flag_lx
+		return;
+	for (int i = 0; i <= MAX_NUM_REF_IDX && !bs.IsError(); i++)
+	{
+		int modification_of_pic_nums_idc = bs.ReadUE();
+		if (modification_of_pic_nums_idc == 3)
+			return;
+		bs.ReadUE(); // abs_diff_pic_num_minus1或long_term_pic_num
+	}
+}
+
+/* pred_weight_table()中的一个列表 */
+static void SkipPredWeightList(BitStream &bs, int count, int chroma_array_type)
+{
+	for (int i = 0; i < count && !bs.IsError(); i++)
+	{
+		if (bs.ReadU1()) // luma_weight_lx_flag
+		{
+			bs.ReadSE(); // luma_weight_lx
+			bs.ReadSE(); // luma_offset_lx
+		}
+		if (chroma_array_type != 0 && bs.ReadU1()) // chroma_weight_lx_flag
+		{
+			for (int j = 0; j < 2; j++)
+			{
+				bs.ReadSE(); // chroma_weight_lx
+				bs.ReadSE(); // chroma_offset_lx
+			}
+		}
+	}
+}
+
+/*
+ * dec_ref_pic_marking()，记录是否出现memory_management_control_operation 5(POC计算需要)
+ * memory_management_control_operation超出0~6或一直没有结束时返回false
+ */
+static bool ParseDecRefPicMarking(BitStream &bs, SliceHeader &sh)
+{
+	if (sh.nal_unit_type == NALU_TYPE_IDR)
+	{
+		sh.no_output_of_prior_pics_flag = bs.ReadU1();
+		sh.long_term_reference_flag = bs.ReadU1();
+		return true;
+	}
+
+	sh.adaptive_ref_pic_marking_mode_flag = bs.ReadU1();
+	if (!sh.adaptive_ref_pic_marking_mode_flag)
+		return true;
+	/* 每种操作的次数有限，这里只防止错误数据导致死循环 */
+	for (int i = 0; i < 2 * MAX_NUM_REF_IDX + 2 && !bs.IsError(); i++)
+	{
+		int mmco = bs.ReadUE();
+		if (mmco == 0)
+			return true;
+		if (mmco < 0 || mmco > 6)
+			return false;
+		if (mmco == 1 || mmco == 3)
+			bs.ReadUE(); // difference_of_pic_nums_minus1
+		if (mmco == 2)
+			bs.ReadUE(); // long_term_pic_num
+		if (mmco == 3 || mmco == 6)
+			bs.ReadUE(); // long_term_frame_idx
+		if (mmco == 4)
+			bs.ReadUE(); // max_long_term_frame_idx_plus1
+		if (mmco == 5)
+			sh.memory_management_control_operation_5 = true;
+	}
+	return false;
+}
+
+/* pic_parameter_set_id之后的字段 */
+static bool ParseSliceRest(BitStream &bs, const SpsInfo &sps, const PpsInfo &pps, SliceHeader &sh, int level)
+{
+	if (pps.pic_parameter_set_id != sh.pic_parameter_set_id
+		|| sps.seq_parameter_set_id != pps.seq_parameter_set_id)
+		return false;
+
+	/* SLICE_PARSE_FRAME_NUM */
+	if (sps.separate_colour_plane_flag)
+		sh.colour_plane_id = bs.ReadU(2);
+	sh.frame_num = bs.ReadU(sps.log2_max_frame_num_minus4 + 4);
+	if (!sps.frame_mbs_only_flag)
+	{
+		sh.field_pic_flag = bs.ReadU1();
+		if (sh.field_pic_flag)
+			sh.bottom_field_flag = bs.ReadU1();
+	}
+	if (bs.IsError())
+		return false;
+	sh.parse_level = SLICE_PARSE_FRAME_NUM;
+	if (level <= SLICE_PARSE_FRAME_NUM)
+		return true;
+
+	/* SLICE_PARSE_POC */
+	if (sh.nal_unit_type == NALU_TYPE_IDR)
+		sh.idr_pic_id = bs.ReadUE();
+	if (sps.pic_order_cnt_type == 0)
+	{
+		sh.pic_order_cnt_lsb = bs.ReadU(sps.log2_max_pic_order_cnt_lsb_minus4 + 4);
+		if (pps.bottom_field_pic_order_in_frame_present_flag && !sh.field_pic_flag)
+			sh.delta_pic_order_cnt_bottom = bs.ReadSE();
+	}
+	if (sps.pic_order_cnt_type == 1 && !sps.delta_pic_order_always_zero_flag)
+	{
+		sh.delta_pic_order_cnt[0] = bs.ReadSE();
+		if (pps.bottom_field_pic_order_in_frame_present_flag && !sh.field_pic_flag)
+			sh.delta_pic_order_cnt[1] = bs.ReadSE();
+	}
+	if (pps.redundant_pic_cnt_present_flag)
+		sh.redundant_pic_cnt = bs.ReadUE();
+	if (bs.IsError())
+		return false;
+	sh.parse_level = SLICE_PARSE_POC;
+	if (level <= SLICE_PARSE_POC)
+		return true;
+
+	/* SLICE_PARSE_ALL */
+	int type = sh.GetSliceType();
+	bool isP = (type == SLICE_TYPE_P || type == SLICE_TYPE_SP);
+	bool isB = (type == SLICE_TYPE_B);
+
+	sh.num_ref_idx_l0_active_minus1 = pps.num_ref_idx_l0_default_active_minus1;
+	sh.num_ref_idx_l1_active_minus1 = pps.num_ref_idx_l1_default_active_minus1;
+	if (isB)
+		sh.direct_spatial_mv_pred_flag = bs.ReadU1();
+	if (isP || isB)
+	{
+		sh.num_ref_idx_active_override_flag = bs.ReadU1();
+		if (sh.num_ref_idx_active_override_flag)
+		{
+			sh.num_ref_idx_l0_active_minus1 = bs.ReadUE();
+			if (isB)
+				sh.num_ref_idx_l1_active_minus1 = bs.ReadUE();
+		}
+	}
+	if (sh.num_ref_idx_l0_active_minus1 < 0 || sh.num_ref_idx_l0_active_minus1 >= MAX_NUM_REF_IDX
+		|| sh.num_ref_idx_l1_active_minus1 < 0 || sh.num_ref_idx_l1_active_minus1 >= MAX_NUM_REF_IDX)
+		return false;
+
+	/* ref_pic_list_modification()，nal_unit_type为20/21的MVC扩展不在此处理 */
+	if (!sh.IsIntra())
+		SkipRefPicListModification(bs);
+	if (isB)
+		SkipRefPicListModification(bs);
+
+	/* pred_weight_table() */
+	if ((pps.weighted_pred_flag && isP) || (pps.weighted_bipred_idc == 1 && isB))
+	{
+		bs.ReadUE(); // luma_log2_weight_denom
+		if (sps.chroma_array_type != 0)
+			bs.ReadUE(); // chroma_log2_weight_denom
+		SkipPredWeightList(bs, sh.num_ref_idx_l0_active_minus1 + 1, sps.chroma_array_type);
+		if (isB)
+			SkipPredWeightList(bs, sh.num_ref_idx_l1_active_minus1 + 1, sps.chroma_array_type);
+	}
+
+	if (sh.nal_ref_idc != 0 && !ParseDecRefPicMarking(bs, sh))
+		return false;
+
+	if (pps.entropy_coding_mode_flag && !sh.IsIntra())
+		sh.cabac_init_idc = bs.ReadUE();
+	sh.slice_qp_delta = bs.ReadSE();
+	if (type == SLICE_TYPE_SP || type == SLICE_TYPE_SI)
+	{
+		if (type == SLICE_TYPE_SP)
+			sh.sp_for_switch_flag = bs.ReadU1();
+		sh.slice_qs_delta = bs.ReadSE();
+	}
+	if (pps.deblocking_filter_control_present_flag)
+	{
+		sh.disable_deblocking_filter_idc = bs.ReadUE();
+		if (sh.disable_deblocking_filter_idc != 1)
+		{
+			sh.slice_alpha_c0_offset_div2 = bs.ReadSE();
+			sh.slice_beta_offset_div2 = bs.ReadSE();
+		}
+	}
+	if (pps.num_slice_groups_minus1 > 0
+		&& pps.slice_group_map_type >= 3 && pps.slice_group_map_type <= 5)
+	{
+		/* 位数为Ceil(Log2(PicSizeInMapUnits ÷ SliceGroupChangeRate + 1)) */
+		long long picSizeInMapUnits = (long long)(sps.pic_width_in_mbs_minus1 + 1) * (sps.pic_height_in_map_units_minus1 + 1);
+		long long sliceGroupChangeRate = pps.slice_group_change_rate_minus1 + 1;
+		int bits = 0;
+		while (bits < 32 && (1LL << bits) * sliceGroupChangeRate < picSizeInMapUnits + sliceGroupChangeRate)
+			bits++;
+		sh.slice_group_change_cycle = bs.ReadU(bits);
+	}
+	if (bs.IsError())
+		return false;
+	sh.parse_level = SLICE_PARSE_ALL;
+	return true;
+}
+
+bool ParseSliceHeader(const unsigned char *data, int len, const SpsInfo &sps, const PpsInfo &pps,
+	SliceHeader &sh, int level)
+{
+	sh.Reset();
+	if (!data || len <= 1)
+		return false;
+
+	int startCodeLen = SkipStartCode(data, len);
+	BitStream bs(data + startCodeLen, len - startCodeLen, true);
+	if (!ParseSliceType(bs, sh))
+		return false;
+	if (level <= SLICE_PARSE_TYPE)
+		return true;
+	return ParseSliceRest(bs, sps, pps, sh, level);
+}
+
+bool ParseSliceHeader(const unsigned char *data, int len, ParamSetCache &cache,
+	SliceHeader &sh, int level)
+{
+	sh.Reset();
+	if (!data || len <= 1)
+		return false;
+
+	int startCodeLen = SkipStartCode(data, len);
+	BitStream bs(data + startCodeLen, len - startCodeLen, true);
+	if (!ParseSliceType(bs, sh))
+		return false;
+	if (level <= SLICE_PARSE_TYPE)
+		return true;
+
+	const PpsInfo *pps = NULL;
+	const SpsInfo *sps = NULL;
+	if (!cache.GetParamSets(sh.pic_parameter_set_id, pps, sps))
+		return false;
+	return ParseSliceRest(bs, *sps, *pps, sh, level);
+}
+
@@ -0,0 +1,107 @@
+/*
+ * H264 slice头解析
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_SLICE_H__
+#define __FREE_EASY_H264_SLICE_H__
+#include "easy_h264_parser.h"
+
+// slice类型：slice_type % 5
+#define SLICE_TYPE_P 0
+#define SLICE_TYPE_B 1
+#define SLICE_TYPE_I 2
+#define SLICE_TYPE_SP 3
+#define SLICE_TYPE_SI 4
+
+// 解析深度：解析完指定的字段后停止，只需要帧类型时不必读完整个slice头
+#define SLICE_PARSE_TYPE 0 // first_mb_in_slice、slice_type、pic_parameter_set_id，不需要SPS/PPS
+#define SLICE_PARSE_FRAME_NUM 1 // 以及colour_plane_id、frame_num、field_pic_flag、bottom_field_flag
+#define SLICE_PARSE_POC 2 // 以及idr_pic_id、pic_order_cnt_lsb、delta_pic_order_cnt等POC相关字段、redundant_pic_cnt
+#define SLICE_PARSE_ALL 3 // 整个slice头，包括参考帧列表修改、加权预测表、参考帧标记
+
+// slice头
+typedef struct SliceHeader
+{
+	SliceHeader()
+	{
+		Reset();
+	}
+
+	/* 恢复默认值 */
+	void Reset();
+
+	/* slice类型：SLICE_TYPE_P等 */
+	int GetSliceType() const
+	{
+		return slice_type % 5;
+	}
+
+	bool IsIntra() const
+	{
+		return GetSliceType() == SLICE_TYPE_I || GetSliceType() == SLICE_TYPE_SI;
+	}
+
+	bool IsIdr() const
+	{
+		return nal_unit_type == NALU_TYPE_IDR;
+	}
+
+	int parse_level; // 实际解析到的深度
+
+	/* NALU头 */
+	int nal_unit_type;
+	int nal_ref_idc;
+
+	/* SLICE_PARSE_TYPE */
+	int first_mb_in_slice;                        // ue(v)
+	int slice_type;                               // ue(v)，0~9，5~9表示整帧都是同一类型
+	int pic_parameter_set_id;                     // ue(v)
+
+	/* SLICE_PARSE_FRAME_NUM */
+	int colour_plane_id;                          // u(2)
+	int frame_num;                                // u(v)
+	bool field_pic_flag;                          // u(1)
+	bool bottom_field_flag;                       // u(1)
+
+	/* SLICE_PARSE_POC */
+	int idr_pic_id;                               // ue(v)
+	int pic_order_cnt_lsb;                        // u(v)
+	int delta_pic_order_cnt_bottom;               // se(v)
+	int delta_pic_order_cnt[2];                   // se(v)
+	int redundant_pic_cnt;                        // ue(v)
+
+	/* SLICE_PARSE_ALL */
+	bool direct_spatial_mv_pred_flag;             // u(1)
+	bool num_ref_idx_active_override_flag;        // u(1)
+	int num_ref_idx_l0_active_minus1;             // ue(v)，未覆盖时为PPS中的默认值
+	int num_ref_idx_l1_active_minus1;             // ue(v)
+	bool no_output_of_prior_pics_flag;            // u(1)
+	bool long_term_reference_flag;                // u(1)
+	bool adaptive_ref_pic_marking_mode_flag;      // u(1)
+	bool memory_management_control_operation_5;   // 是否包含memory_management_control_operation等于5
+	int cabac_init_idc;                           // ue(v)
+	int slice_qp_delta;                           // se(v)
+	bool sp_for_switch_flag;                      // u(1)
+	int slice_qs_delta;                           // se(v)
+	int disable_deblocking_filter_idc;            // ue(v)
+	int slice_alpha_c0_offset_div2;               // se(v)
+	int slice_beta_offset_div2;                   // se(v)
+	int slice_group_change_cycle;                 // u(v)
+}SliceHeader;
+
+/*
+ * 解析slice头，data为NALU_TYPE_SLICE/NALU_TYPE_IDR(可以包含起始码)，按EBSP读取
+ * level为解析深度SLICE_PARSE_xxx，解析完该深度的字段后即返回
+ * 成功返回true，数据不足或字段取值非法时返回false
+ */
+bool ParseSliceHeader(const unsigned char *data, int len, const SpsInfo &sps, const PpsInfo &pps,
+	SliceHeader &sh, int level = SLICE_PARSE_ALL);
+
+/* 同上，根据slice中的pic_parameter_set_id从cache中查找SPS/PPS，找不到时返回false */
+bool ParseSliceHeader(const unsigned char *data, int len, ParamSetCache &cache,
+	SliceHeader &sh, int level = SLICE_PARSE_ALL);
+
+#endif
+
@@ -0,0 +1,153 @@
+/*
+ * 解析器统计实现
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <string.h>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include "easy_h264_stats.h"
+
+static const char *counterNames[H264_STAT_COUNTER_COUNT] = {
+	"bytes_scanned", "nalus", "read_bytes", "refills", "carry_bytes", "move_bytes",
+	"allocs", "alloc_bytes", "sps", "pps", "param_errors", "param_cache_hits"
+};
+
+static const char *stageNames[H264_STAGE_COUNT] = {
+	"scan", "read", "sps", "pps"
+};
+
+const char *GetH264StatName(int counter)
+{
+	return (counter >= 0 && counter < H264_STAT_COUNTER_COUNT) ? counterNames[counter] : "unknown";
+}
+
+const char *GetH264StageName(int stage)
+{
+	return (stage >= 0 && stage < H264_STAGE_COUNT) ? stageNames[stage] : "unknown";
+}
+
+void PrintH264Stats(const H264Stats &stats, FILE *fp)
+{
+	if (!fp)
+		return;
+	for (int i = 0; i < H264_STAT_COUNTER_COUNT; i++)
+	{
+		if (stats.counters[i])
+			fprintf(fp, "%-20s %llu\n", counterNames[i], stats.counters[i]);
+	}
+	for (int i = 0; i < 32; i++)
+	{
+		if (stats.nalu_types[i])
+			fprintf(fp, "nalu_type_%-10d %llu\n", i, stats.nalu_types[i]);
+	}
+	for (int i = 0; i < H264_STAGE_COUNT; i++)
+	{
+		if (stats.stage_calls[i])
+			fprintf(fp, "stage_%-14s %.3f ms, %llu calls\n", stageNames[i], stats.stage_ns[i] / 1e6, stats.stage_calls[i]);
+	}
+}
+
+#ifdef EASY_H264_STATS
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 每线程计数器
+thread_local H264StatBlock *h264StatLocal = NULL;
+
+static std::mutex statMutex;
+static std::vector<H264StatBlock *> statBlocks; // 所有存活线程的计数器
+static unsigned long long statRetired[H264_STAT_SLOT_COUNT]; // 已退出线程的累计值
+static unsigned long long statBase[H264_STAT_SLOT_COUNT]; // ResetH264Stats时的值
+
+/* 线程退出时把计数器合并到statRetired */
+class H264StatOwner
+{
+public:
+	~H264StatOwner()
+	{
+		H264StatBlock *block = h264StatLocal;
+		if (!block)
+			return;
+		std::lock_guard<std::mutex> lock(statMutex);
+		for (int i = 0; i < H264_STAT_SLOT_COUNT; i++)
+			statRetired[i] += block->slots[i].load(std::memory_order_relaxed);
+		statBlocks.erase(std::remove(statBlocks.begin(), statBlocks.end(), block), statBlocks.end());
+		delete block;
+		h264StatLocal = NULL;
+		exited = true;
+	}
+
+	bool exited = false;
+};
+
+static thread_local H264StatOwner statOwner;
+
+H264StatBlock *H264StatRegister()
+{
+	/* 线程退出过程中(其他thread_local对象析构时)的统计直接丢弃 */
+	static H264StatBlock discard;
+	if (statOwner.exited)
+		return &discard;
+
+	H264StatBlock *block = new H264StatBlock;
+	for (int i = 0; i < H264_STAT_SLOT_COUNT; i++)
+		block->slots[i].store(0, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(statMutex);
+		statBlocks.push_back(block);
+	}
+	h264StatLocal = block;
+	return block;
+}
+
+static void SumSlots(unsigned long long *sum)
+{
+	memcpy(sum, statRetired, sizeof(statRetired));
+	for (size_t i = 0; i < statBlocks.size(); i++)
+	{
+		for (int k = 0; k < H264_STAT_SLOT_COUNT; k++)
+			sum[k] += statBlocks[i]->slots[k].load(std::memory_order_relaxed);
+	}
+}
+
+bool H264StatsEnabled()
+{
+	return true;
+}
+
+void GetH264Stats(H264Stats &stats)
+{
+	unsigned long long sum[H264_STAT_SLOT_COUNT];
+	{
+		std::lock_guard<std::mutex> lock(statMutex);
+		SumSlots(sum);
+		for (int k = 0; k < H264_STAT_SLOT_COUNT; k++)
+			sum[k] -= statBase[k];
+	}
+	memcpy(stats.counters, sum, sizeof(stats.counters));
+	memcpy(stats.nalu_types, sum + H264_STAT_SLOT_NALU_TYPE, sizeof(stats.nalu_types));
+	memcpy(stats.stage_ns, sum + H264_STAT_SLOT_STAGE_NS, sizeof(stats.stage_ns));
+	memcpy(stats.stage_calls, sum + H264_STAT_SLOT_STAGE_CALLS, sizeof(stats.stage_calls));
+}
+
+void ResetH264Stats()
+{
+	std::lock_guard<std::mutex> lock(statMutex);
+	SumSlots(statBase);
+}
+#else
+bool H264StatsEnabled()
+{
+	return false;
+}
+
+void GetH264Stats(H264Stats &stats)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+void ResetH264Stats()
+{}
+#endif
+
@@ -0,0 +1,135 @@
+/*
+ * 解析器统计：扫描字节数、各类型NALU个数、读取/拷贝/分配次数及各阶段耗时
+ * 编译时定义EASY_H264_STATS才启用(make STATS=1)，否则统计代码全部去掉，快照全为0
+ * 每个线程写自己的计数器，读取时合并，多线程解析时没有竞争
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_STATS_H__
+#define __FREE_EASY_H264_STATS_H__
+#include <stdio.h>
+
+// 计数器
+enum
+{
+	H264_STAT_BYTES_SCANNED = 0, // 查找起始码扫描的字节数
+	H264_STAT_NALUS, // 输出的NALU个数，各类型的个数见nalu_types
+	H264_STAT_READ_BYTES, // 从文件读取的字节数
+	H264_STAT_REFILLS, // 分块读取/异步预读取出新块的次数
+	H264_STAT_CARRY_BYTES, // 块末尾不完整的NALU留到下一块的字节数
+	H264_STAT_MOVE_BYTES, // memmove/memcpy搬移数据的字节数
+	H264_STAT_ALLOCS, // 解析器缓冲区的分配次数
+	H264_STAT_ALLOC_BYTES, // 解析器缓冲区分配的字节数
+	H264_STAT_SPS, // 解析的SPS个数
+	H264_STAT_PPS, // 解析的PPS个数
+	H264_STAT_PARAM_ERRORS, // SPS/PPS解析失败的次数
+	H264_STAT_PARAM_CACHE_HITS, // ParamSetCache中内容未变化、无需重新解析的次数
+	H264_STAT_COUNTER_COUNT
+};
+
+// 计时阶段
+enum
+{
+	H264_STAGE_SCAN = 0, // 查找起始码、生成NALU
+	H264_STAGE_READ, // 读取文件(异步预读方式下为等待读取完成的时间)
+	H264_STAGE_SPS, // SPS解析
+	H264_STAGE_PPS, // PPS解析
+	H264_STAGE_COUNT
+};
+
+// 计数器在每个线程中的存放位置：计数器、各类型NALU个数、各阶段耗时、各阶段次数
+#define H264_STAT_SLOT_NALU_TYPE H264_STAT_COUNTER_COUNT
+#define H264_STAT_SLOT_STAGE_NS (H264_STAT_SLOT_NALU_TYPE + 32)
+#define H264_STAT_SLOT_STAGE_CALLS (H264_STAT_SLOT_STAGE_NS + H264_STAGE_COUNT)
+#define H264_STAT_SLOT_COUNT (H264_STAT_SLOT_STAGE_CALLS + H264_STAGE_COUNT)
+
+// 统计快照：所有线程(包括已退出的线程)合并后的值
+typedef struct H264Stats
+{
+	unsigned long long counters[H264_STAT_COUNTER_COUNT];
+	unsigned long long nalu_types[32];
+	unsigned long long stage_ns[H264_STAGE_COUNT];
+	unsigned long long stage_calls[H264_STAGE_COUNT];
+}H264Stats;
+
+/* 编译时是否启用了统计 */
+bool H264StatsEnabled();
+
+/* 获取快照：ResetH264Stats之后的累计值 */
+void GetH264Stats(H264Stats &stats);
+
+/* 清零：记录当前值作为起点，不影响正在写计数器的线程 */
+void ResetH264Stats();
+
+const char *GetH264StatName(int counter);
+const char *GetH264StageName(int stage);
+
+/* 输出快照，值为0的项不输出 */
+void PrintH264Stats(const H264Stats &stats, FILE *fp = stdout);
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 解析器内部使用的统计宏
+#ifdef EASY_H264_STATS
+#include <time.h>
+#include <atomic>
+
+typedef struct H264StatBlock
+{
+	std::atomic<unsigned long long> slots[H264_STAT_SLOT_COUNT];
+}H264StatBlock;
+
+extern thread_local H264StatBlock *h264StatLocal;
+
+/* 为当前线程创建计数器，线程退出时合并到全局 */
+H264StatBlock *H264StatRegister();
+
+/* 只有本线程写：普通的读-加-写即可，atomic只是为了其他线程读取时没有数据竞争 */
+static inline void H264StatAdd(int slot, long long n)
+{
+	H264StatBlock *block = h264StatLocal;
+	if (!block)
+		block = H264StatRegister();
+	std::atomic<unsigned long long> &v = block->slots[slot];
+	v.store(v.load(std::memory_order_relaxed) + (unsigned long long)n, std::memory_order_relaxed);
+}
+
+// 作用域计时：析构时累加耗时及次数
+class H264StageTimer
+{
+public:
+	explicit H264StageTimer(int stage)
+	{
+		this->stage = stage;
+		start = Now();
+	}
+
+	~H264StageTimer()
+	{
+		H264StatAdd(H264_STAT_SLOT_STAGE_NS + stage, (long long)(Now() - start));
+		H264StatAdd(H264_STAT_SLOT_STAGE_CALLS + stage, 1);
+	}
+
+private:
+	static unsigned long long Now()
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+	int stage;
+	unsigned long long start;
+};
+
+#define H264_STAT_ADD(counter, n) H264StatAdd((counter), (n))
+#define H264_STAT_NALU(type, n) do { H264StatAdd(H264_STAT_NALUS, (n)); H264StatAdd(H264_STAT_SLOT_NALU_TYPE + ((type) & 0x1f), (n)); } while (0)
+#define H264_STAT_TIMER(stage) H264StageTimer h264StageTimer(stage)
+#else
+#define H264_STAT_ADD(counter, n) ((void)0)
+#define H264_STAT_NALU(type, n) ((void)0)
+#define H264_STAT_TIMER(stage) ((void)0)
+#endif
+
+#endif
+
@@ -0,0 +1,428 @@
+/*
+ * MPEG-2 TS解复用：解析PAT/PMT，重组H264视频PID的PES，提取PTS/DTS并拆分NALU
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#include <stdio.h>
+#include <string.h>
+#include "easy_h264_ts.h"
+
+#define TS_READ_SIZE (TS_PACKET_SIZE * 2048) // ScanTsFile每次读取的字节数
+#define PES_HEADER_SIZE 9 // packet_start_code_prefix到PES_header_data_length
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 工具函数
+
+/* PSI的CRC32(多项式0x04C11DB7，不反转)，包含CRC_32字段计算时结果为0 */
+static unsigned int Crc32(const unsigned char *data, int len)
+{
+	unsigned int crc = 0xFFFFFFFF;
+	for (int i = 0; i < len; i++)
+	{
+		crc ^= (unsigned int)data[i] << 24;
+		for (int j = 0; j < 8; j++)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+	}
+	return crc;
+}
+
+/* PTS/DTS：33位分3段，每段后跟marker_bit */
+static long long ReadTimestamp(const unsigned char *p)
+{
+	return ((long long)((p[0] >> 1) & 0x07) << 30) | ((long long)p[1] << 22)
+		| ((long long)(p[2] >> 1) << 15) | ((long long)p[3] << 7) | (p[4] >> 1);
+}
+
+/* 展开33位时间戳的回绕：取与ref相差不超过2^32的值(ref为展开后的值) */
+static long long UnwrapTimestamp(long long raw, long long ref)
+{
+	if (ref == TS_NO_TIMESTAMP)
+		return raw;
+	long long value = (ref & ~TS_TIMESTAMP_MASK) | raw;
+	if (value - ref > TS_TIMESTAMP_WRAP / 2)
+		value -= TS_TIMESTAMP_WRAP;
+	else if (ref - value > TS_TIMESTAMP_WRAP / 2)
+		value += TS_TIMESTAMP_WRAP;
+	return value;
+}
+
+static void ResetTimestamp(TsTimestamp &ts)
+{
+	ts.pts = TS_NO_TIMESTAMP;
+	ts.dts = TS_NO_TIMESTAMP;
+	ts.pes_start = false;
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// TS解复用
+H264TsDemux::H264TsDemux(const TsNaluCallback &callback, int programNumber, H264Allocator *allocator)
+	: pesBuffer(allocator), naluParse(true), auParse(true)
+{
+	this->callback = callback;
+	wantedProgram = programNumber;
+	Reset();
+}
+
+void H264TsDemux::Reset()
+{
+	programNumber = -1;
+	pmtPid = -1;
+	videoPid = -1;
+	packetCount = 0;
+	ccErrors = 0;
+	partialLen = 0;
+	pat.length = -1;
+	pat.cc = -1;
+	pmt.length = -1;
+	pmt.cc = -1;
+	lastDts = TS_NO_TIMESTAMP;
+	DropPes();
+	auParse.Reset();
+	au.Clear();
+	auEmpty = true;
+	ResetTimestamp(auTs);
+}
+
+// 输入数据
+void H264TsDemux::Feed(const unsigned char *data, int len)
+{
+	if (!data || len <= 0)
+		return;
+
+	const unsigned char *p = data;
+	const unsigned char *end = data + len;
+
+	/* 先补齐上次剩下的不完整TS包 */
+	if (partialLen > 0)
+	{
+		int n = TS_PACKET_SIZE - partialLen;
+		if (n > len)
+			n = len;
+		memcpy(partial + partialLen, p, n);
+		partialLen += n;
+		p += n;
+		if (partialLen < TS_PACKET_SIZE)
+			return;
+		partialLen = 0;
+		ParsePacket(partial);
+	}
+
+	/* 完整的TS包直接在输入数据中解析 */
+	while (end - p >= TS_PACKET_SIZE)
+	{
+		/* 下一个包也在输入中时要求它也以同步字节开始，避免负载中的0x47造成错误的同步 */
+		if (p[0] != TS_SYNC_BYTE || (end - p > TS_PACKET_SIZE && p[TS_PACKET_SIZE] != TS_SYNC_BYTE))
+		{
+			/* 丢失同步：查找下一个同步字节，同样要求其后一个包以同步字节开始 */
+			const unsigned char *q = (const unsigned char *)memchr(p + 1, TS_SYNC_BYTE, end - p - 1);
+			while (q && end - q > TS_PACKET_SIZE && q[TS_PACKET_SIZE] != TS_SYNC_BYTE)
+				q = (const unsigned char *)memchr(q + 1, TS_SYNC_BYTE, end - q - 1);
+			if (!q)
+			{
+				p = end;
+				break;
+			}
+			p = q;
+			continue;
+		}
+		ParsePacket(p);
+		p += TS_PACKET_SIZE;
+	}
+
+	/* 不完整的包留到下次输入，没有对齐时从下一个同步字节开始 */
+	if (p < end)
+	{
+		const unsigned char *q = p[0] == TS_SYNC_BYTE ? p : (const unsigned char *)memchr(p, TS_SYNC_BYTE, end - p);
+		if (q)
+		{
+			partialLen = end - q;
+			memcpy(partial, q, partialLen);
+		}
+	}
+}
+
+// 输入结束
+void H264TsDemux::Flush()
+{
+	partialLen = 0;
+	if (pesStarted)
+		OutputPes();
+	if (frameCallback && auParse.Flush(au))
+		frameCallback(au, auTs);
+	auEmpty = true;
+}
+
+void H264TsDemux::ParsePacket(const unsigned char *pkt)
+{
+	packetCount++;
+	if (pkt[1] & 0x80) // transport_error_indicator
+		return;
+
+	bool unitStart = (pkt[1] & 0x40) != 0;
+	int pid = ((pkt[1] & 0x1F) << 8) | pkt[2];
+	int control = (pkt[3] >> 4) & 0x03; // adaptation_field_control
+	int cc = pkt[3] & 0x0F;
+	if (pid == TS_PID_NULL || !(control & 0x01)) // 没有负载的包continuity_counter不增加
+		return;
+
+	const unsigned char *p = pkt + 4;
+	const unsigned char *end = pkt + TS_PACKET_SIZE;
+	bool discontinuity = false;
+	if (control & 0x02)
+	{
+		int afLen = p[0];
+		if (afLen > 0)
+			discontinuity = (p[1] & 0x80) != 0;
+		p += 1 + afLen;
+		if (p >= end) // adaptation_field占满整个包，没有负载
+			return;
+	}
+
+	if (pid == videoPid)
+	{
+		if (pesCc >= 0 && !discontinuity && cc != ((pesCc + 1) & 0x0F))
+		{
+			if (cc == pesCc) // 重复包
+				return;
+			ccErrors++;
+			DropPes();
+		}
+		pesCc = cc;
+		PushPes(p, end - p, unitStart);
+	}
+	else if (pid == TS_PID_PAT || pid == pmtPid)
+	{
+		TsSection &section = pid == TS_PID_PAT ? pat : pmt;
+		if (section.cc >= 0 && !discontinuity && cc != ((section.cc + 1) & 0x0F))
+		{
+			if (cc == section.cc)
+				return;
+			section.length = -1;
+		}
+		section.cc = cc;
+		PushSection(section, p, end - p, unitStart);
+	}
+}
+
+/* 只处理每个包中开始的第一个section，PAT/PMT通常只有一个section，之后是0xFF填充 */
+void H264TsDemux::PushSection(TsSection &section, const unsigned char *p, int len, bool unitStart)
+{
+	if (len <= 0)
+		return;
+	const unsigned char *end = p + len;
+	if (unitStart)
+	{
+		int pointer = p[0]; // pointer_field：之前是上一个section的剩余部分
+		p++;
+		if (p + pointer > end)
+		{
+			section.length = -1;
+			return;
+		}
+		if (section.length >= 0)
+			PushSection(section, p, pointer, false);
+		p += pointer;
+		section.length = 0;
+	}
+	if (section.length < 0)
+		return;
+
+	while (p < end)
+	{
+		/* 前3个字节得到section_length后才知道需要的长度 */
+		int need = section.length < 3 ? 3 : 3 + (((section.data[1] & 0x0F) << 8) | section.data[2]);
+		if (need > (int)sizeof(section.data) || (section.length >= 1 && section.data[0] == 0xFF))
+		{
+			section.length = -1; // 长度错误或只有填充
+			return;
+		}
+		int n = need - section.length;
+		if (n > end - p)
+			n = end - p;
+		memcpy(section.data + section.length, p, n);
+		section.length += n;
+		p += n;
+		if (section.length == need && need > 3)
+		{
+			if (Crc32(section.data, need) == 0)
+			{
+				if (&section == &pat)
+					ParsePat(section.data, need);
+				else
+					ParsePmt(section.data, need);
+			}
+			section.length = -1;
+			return;
+		}
+	}
+}
+
+void H264TsDemux::ParsePat(const unsigned char *data, int len)
+{
+	/* table_id、section_syntax_indicator、current_next_indicator */
+	if (len < 12 || data[0] != 0x00 || !(data[1] & 0x80) || !(data[5] & 0x01))
+		return;
+
+	for (const unsigned char *p = data + 8; p + 4 <= data + len - 4; p += 4)
+	{
+		int number = (p[0] << 8) | p[1];
+		int pid = ((p[2] & 0x1F) << 8) | p[3];
+		if (number == 0) // network_PID
+			continue;
+		if (wantedProgram > 0 && number != wantedProgram)
+			continue;
+		if (pid != pmtPid)
+		{
+			pmtPid = pid;
+			pmt.length = -1;
+			pmt.cc = -1;
+		}
+		programNumber = number;
+		return;
+	}
+}
+
+void H264TsDemux::ParsePmt(const unsigned char *data, int len)
+{
+	if (len < 16 || data[0] != 0x02 || !(data[1] & 0x80) || !(data[5] & 0x01))
+		return;
+	if (((data[3] << 8) | data[4]) != programNumber)
+		return;
+
+	int pid = -1;
+	int infoLen = ((data[10] & 0x0F) << 8) | data[11]; // program_info_length
+	const unsigned char *p = data + 12 + infoLen;
+	const unsigned char *end = data + len - 4; // 去掉CRC_32
+	while (p + 5 <= end)
+	{
+		int streamType = p[0];
+		int esPid = ((p[1] & 0x1F) << 8) | p[2];
+		if (streamType == TS_STREAM_TYPE_H264)
+		{
+			pid = esPid;
+			break;
+		}
+		p += 5 + (((p[3] & 0x0F) << 8) | p[4]); // ES_info_length
+	}
+
+	/* 视频PID变化时丢弃重组到一半的PES */
+	if (pid != videoPid)
+	{
+		DropPes();
+		videoPid = pid;
+	}
+}
+
+void H264TsDemux::PushPes(const unsigned char *p, int len, bool unitStart)
+{
+	if (unitStart)
+	{
+		if (pesStarted)
+			OutputPes();
+		pesStarted = true;
+		pesLength = 0;
+		pesExpected = -1;
+	}
+	if (!pesStarted || len <= 0) // 还没有等到PES的开始
+		return;
+
+	AppendPes(p, len);
+
+	/* 前6个字节得到PES_packet_length，不为0时到达该长度就输出，不必等下一个PES */
+	if (pesExpected < 0 && pesLength >= 6)
+	{
+		unsigned char *pes = pesBuffer.GetData();
+		int packetLen = (pes[4] << 8) | pes[5];
+		pesExpected = packetLen > 0 ? 6 + packetLen : 0;
+	}
+	if (pesExpected > 0 && pesLength >= pesExpected)
+		OutputPes();
+}
+
+void H264TsDemux::AppendPes(const unsigned char *p, int len)
+{
+	unsigned char *pes = pesBuffer.Grow(pesLength + len, pesLength);
+	memcpy(pes + pesLength, p, len);
+	pesLength += len;
+}
+
+void H264TsDemux::DropPes()
+{
+	pesStarted = false;
+	pesLength = 0;
+	pesExpected = -1;
+	pesCc = -1;
+}
+
+void H264TsDemux::OutputPes()
+{
+	unsigned char *pes = pesBuffer.GetData();
+	int len = pesLength;
+	pesStarted = false;
+	pesLength = 0;
+	if (pesExpected > 0 && len > pesExpected)
+		len = pesExpected;
+	pesExpected = -1;
+
+	/* packet_start_code_prefix及视频流的可选PES头('10'开始) */
+	if (len < PES_HEADER_SIZE || pes[0] != 0 || pes[1] != 0 || pes[2] != 1 || (pes[6] & 0xC0) != 0x80)
+		return;
+	int flags = pes[7] >> 6; // PTS_DTS_flags
+	int payload = PES_HEADER_SIZE + pes[8];
+	if (payload > len)
+		return;
+
+	/* DTS按上一个PES的DTS展开回绕，PTS不小于DTS，按本PES的DTS展开 */
+	TsTimestamp ts;
+	ResetTimestamp(ts);
+	if ((flags & 0x02) && pes[8] >= 5)
+	{
+		long long pts = ReadTimestamp(pes + PES_HEADER_SIZE);
+		long long dts = pts;
+		if (flags == 0x03 && pes[8] >= 10)
+			dts = ReadTimestamp(pes + PES_HEADER_SIZE + 5);
+		ts.dts = UnwrapTimestamp(dts, lastDts);
+		ts.pts = UnwrapTimestamp(pts, ts.dts);
+		lastDts = ts.dts;
+	}
+
+	/* 零拷贝拆分：Nalu直接指向重组缓冲区 */
+	std::vector<Nalu> &nalus = naluParse.GetNalusFromFrame(pes + payload, len - payload);
+	for (size_t i = 0; i < nalus.size(); i++)
+	{
+		ts.pes_start = (i == 0);
+		if (callback)
+			callback(nalus[i], ts);
+		if (!frameCallback)
+			continue;
+
+		/* 新访问单元从这个NALU开始，沿用它的时间戳 */
+		if (auParse.Push(nalus[i], au))
+		{
+			frameCallback(au, auTs);
+			auTs = ts;
+		}
+		else if (auEmpty)
+			auTs = ts;
+		auEmpty = false;
+	}
+}
+
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// 读取TS文件
+bool ScanTsFile(const std::string &filename, H264TsDemux &demux)
+{
+	FILE *fp = fopen(filename.c_str(), "rb");
+	if (!fp)
+		return false;
+
+	ScratchBuffer buffer;
+	unsigned char *data = buffer.Reserve(TS_READ_SIZE);
+	size_t n = 0;
+	while ((n = fread(data, 1, TS_READ_SIZE, fp)) > 0)
+		demux.Feed(data, (int)n);
+	demux.Flush();
+	fclose(fp);
+	return true;
+}
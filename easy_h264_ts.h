@@ -0,0 +1,155 @@
+/*
+ * MPEG-2 TS解复用：解析PAT/PMT，重组H264视频PID的PES，提取PTS/DTS并拆分NALU
+ * Copyright FreeCode. All Rights Reserved.
+ * MIT License (https://opensource.org/licenses/MIT)
+ * 2025 by liuqingshuige
+ */
+#ifndef __FREE_EASY_H264_TS_H__
+#define __FREE_EASY_H264_TS_H__
+#include "easy_h264_frame.h"
+
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define TS_PID_PAT 0x0000
+#define TS_PID_NULL 0x1FFF
+#define TS_STREAM_TYPE_H264 0x1B // stream_type(ISO/IEC 13818-1表2-34)
+#define TS_MAX_SECTION_SIZE 1024 // PAT/PMT的section_length最大为1021
+#define TS_NO_TIMESTAMP (-1LL)
+#define TS_TIMESTAMP_HZ 90000 // PTS/DTS的时钟频率
+#define TS_TIMESTAMP_WRAP (1LL << 33) // PTS/DTS为33位，约26.5小时回绕一次
+#define TS_TIMESTAMP_MASK (TS_TIMESTAMP_WRAP - 1)
+
+/*
+ * PES的时间戳，单位为1/90000秒
+ * 码流中的PTS/DTS只有33位，这里已按上一个PES展开回绕，回绕后继续递增(可以超过2^33)，
+ * 需要码流中的原始值时与TS_TIMESTAMP_MASK相与；Reset()之后重新从码流中的值开始
+ */
+typedef struct TsTimestamp
+{
+	long long pts; // 没有时为TS_NO_TIMESTAMP
+	long long dts; // PES中没有DTS时等于pts
+	bool pes_start; // 该NALU(访问单元)是PES中的第一个，时间戳只对它准确，其余的沿用PES的时间戳
+}TsTimestamp;
+
+// NALU回调：nalu指向PES重组缓冲区，只在回调期间有效
+typedef std::function<void(Nalu &nalu, const TsTimestamp &ts)> TsNaluCallback;
+
+// 访问单元回调：au只在回调期间有效，可以用swap取走
+typedef std::function<void(AccessUnit &au, const TsTimestamp &ts)> TsFrameCallback;
+
+/*
+ * TS解复用(推模式)：输入可以按任意长度分块，丢失同步时按同步字节重新对齐
+ * 选择第一个(或指定的)节目中第一个stream_type为0x1B的PID，PMT变化时重新选择
+ * 完整的TS包直接在输入数据中解析，PES负载只拷贝一次到复用的重组缓冲区，
+ * 之后用零拷贝的NaluParse拆分NALU，回调中的Nalu直接指向重组缓冲区
+ * PES在下一个payload_unit_start或PES_packet_length到达时输出；continuity_counter不连续时丢弃当前PES
+ * 每个PES单独拆分NALU，不处理跨PES的NALU(H.222要求H264的PES从访问单元开始)
+ */
+class H264TsDemux
+{
+public:
+	H264TsDemux() = delete;
+	/* programNumber小于等于0时选择PAT中的第一个节目；allocator用于PES重组缓冲区，NULL时使用默认分配器 */
+	explicit H264TsDemux(const TsNaluCallback &callback, int programNumber = 0, H264Allocator *allocator = NULL);
+	~H264TsDemux()
+	{}
+
+	H264TsDemux(const H264TsDemux &b) = delete;
+	H264TsDemux &operator=(const H264TsDemux &b) = delete;
+
+	/*
+	 * 同时按访问单元输出：NALU回调之后再组装访问单元(拷贝模式的AccessUnitParse)，
+	 * 时间戳取访问单元第一个NALU所在PES的时间戳，不是PES中第一个访问单元时pes_start为false
+	 */
+	void SetFrameCallback(const TsFrameCallback &callback)
+	{
+		frameCallback = callback;
+	}
+
+	/* 输入TS数据 */
+	void Feed(const unsigned char *data, int len);
+
+	/* 输入结束，输出未完成的PES及最后一个访问单元 */
+	void Flush();
+
+	/* 丢弃缓存的数据及PAT/PMT，重新开始 */
+	void Reset();
+
+	/* 当前选中的视频PID，还没有找到时为-1 */
+	int GetVideoPid()
+	{
+		return videoPid;
+	}
+
+	/* 当前选中的节目号，还没有找到时为-1 */
+	int GetProgramNumber()
+	{
+		return programNumber;
+	}
+
+	/* 已处理的TS包个数 */
+	unsigned long long GetPacketCount()
+	{
+		return packetCount;
+	}
+
+	/* 视频PID的continuity_counter不连续次数 */
+	unsigned long long GetContinuityErrors()
+	{
+		return ccErrors;
+	}
+
+private:
+	/* PAT/PMT的section重组 */
+	typedef struct TsSection
+	{
+		unsigned char data[TS_MAX_SECTION_SIZE + 3];
+		int length; // 已收到的字节数
+		int cc; // 上一个包的continuity_counter，-1表示没有
+	}TsSection;
+
+	void ParsePacket(const unsigned char *pkt);
+	void PushSection(TsSection &section, const unsigned char *p, int len, bool unitStart);
+	void ParsePat(const unsigned char *data, int len);
+	void ParsePmt(const unsigned char *data, int len);
+	void PushPes(const unsigned char *p, int len, bool unitStart);
+	void AppendPes(const unsigned char *p, int len);
+	void OutputPes();
+	void DropPes();
+
+	TsNaluCallback callback;
+	TsFrameCallback frameCallback;
+	int wantedProgram;
+	int programNumber;
+	int pmtPid;
+	int videoPid;
+	unsigned long long packetCount;
+	unsigned long long ccErrors;
+
+	/* 跨两次输入的不完整TS包 */
+	unsigned char partial[TS_PACKET_SIZE];
+	int partialLen;
+
+	TsSection pat;
+	TsSection pmt;
+
+	/* PES重组 */
+	ScratchBuffer pesBuffer;
+	int pesLength; // pesBuffer中已有的字节数(从PES头开始)
+	int pesExpected; // 按PES_packet_length计算的PES总长度，0表示不限长度，-1表示还没有收到PES_packet_length
+	int pesCc; // 视频PID上一个包的continuity_counter，-1表示没有
+	bool pesStarted; // 是否正在重组PES
+	long long lastDts; // 上一个带时间戳的PES展开回绕后的DTS，用于展开下一个PES的时间戳
+
+	NaluParse naluParse; // 零拷贝拆分重组好的PES
+	AccessUnitParse auParse; // 只在设置了frameCallback时使用
+	AccessUnit au;
+	bool auEmpty; // auParse中还没有正在组装的访问单元
+	TsTimestamp auTs; // 正在组装的访问单元的时间戳
+};
+
+/* 顺序读取整个TS文件送入demux，每次读取的块为TS包大小的整数倍，文件打开失败时返回false */
+bool ScanTsFile(const std::string &filename, H264TsDemux &demux);
+
+#endif
+
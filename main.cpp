@@ -1,4 +1,5 @@
 #include "easy_h264_parser.h"
+#include "easy_h264_stats.h"
 #include <sys/time.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -77,8 +78,8 @@ int main(int argc, char **argv)
 		return -1;
 	}
 
-	// 读取H264文件数据，并解析出所有帧
-	NaluParse parse;
+	// 读取H264文件数据，并解析出所有帧(零拷贝：frames直接指向pdata，free之前有效)
+	NaluParse parse(true);
 	int len = 0;
 	int last_pos = -1;
 	char *pdata = LoadFile(argv[1], &len);
@@ -132,6 +133,15 @@ int main(int argc, char **argv)
 		LOG("idx: %d, type: 0x%x, Size: %d\n", idx++, type, Size);
 	}
 
+	// make STATS=1编译时输出解析器统计
+	if (H264StatsEnabled())
+	{
+		H264Stats stats;
+		GetH264Stats(stats);
+		printf("\n=====parser stats=====\n\n");
+		PrintH264Stats(stats);
+	}
+
 	return 0;
 }
 